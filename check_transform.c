@@ -0,0 +1,487 @@
+// ===== check_transform.c =====
+// Per pixel reference check of the frame transforms in device_verification.c: 8x8 transpose,
+// panel rotation (block and remainder paths) and the resampling stage (nearest/bilinear/box,
+// letterbox), the frame content keys, blend565_span() and the compositor's damage tracking
+// against a full redraw. Built and run by `make check`; needs no device.
+// `check_transform --bench` (make bench) times the scaler per filter and the fused
+// scale + rotate present for the source sizes the panel is fed with.
+
+#define main device_verification_main   // the demo's main() is not used here
+#include "device_verification.c"
+#undef main
+
+static int failures = 0;
+
+static void fail(const char *what, int x, int y, unsigned got, unsigned want) {
+    if (failures++ < 10) fprintf(stderr, "FAIL %s at (%d,%d): got 0x%04x want 0x%04x\n", what, x, y, got, want);
+}
+
+static uint32_t rng_state = 12345;
+static uint16_t rnd16(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return (uint16_t)(rng_state >> 16);
+}
+
+static void fill_random(uint16_t *p, size_t n) {
+    for (size_t i = 0; i < n; i++) p[i] = rnd16();
+}
+
+/* ---------- transpose ---------- */
+
+static void check_transpose(void) {
+    for (int iter = 0; iter < 100; iter++) {
+        uint16_t in[8][8];
+        v8u16 r[8];
+        for (int i = 0; i < 8; i++) for (int j = 0; j < 8; j++) in[i][j] = rnd16();
+        for (int i = 0; i < 8; i++) memcpy(&r[i], in[i], 16);
+        transpose8x8_u16(r);
+        for (int i = 0; i < 8; i++) for (int j = 0; j < 8; j++)
+            if (r[j][i] != in[i][j]) fail("transpose8x8_u16", i, j, r[j][i], in[i][j]);
+    }
+}
+
+/* ---------- rotation ---------- */
+
+/* reference: logical (lx,ly) -> panel offset, see the rotation section */
+static size_t ref_rotate_offset(int rot, int lw, int lh, int lx, int ly) {
+    switch (rot) {
+    case 90:  return (size_t)lx * WIDTH + (size_t)(lh - 1 - ly);
+    case 180: return (size_t)(lh - 1 - ly) * WIDTH + (size_t)(lw - 1 - lx);
+    case 270: return (size_t)(lw - 1 - lx) * WIDTH + (size_t)ly;
+    default:  return (size_t)ly * WIDTH + (size_t)lx;
+    }
+}
+
+static void check_rotation(uint16_t *src, uint16_t *dst) {
+    static const int rots[] = { 90, 180, 270 };
+    for (int k = 0; k < 3; k++) {
+        int rot = rots[k];
+        char what[64];
+
+        // whole frame through present_frame() (band + 8x8 block path)
+        rotation_init(rot);
+        fill_random(src, (size_t)g_logical_w * g_logical_h);
+        memset(dst, 0, FRAME_BYTES);
+        g_canvas = (canvas_t){ src, g_logical_w, g_logical_h };
+        present_frame(dst);
+        snprintf(what, sizeof(what), "present_frame rotate %d", rot);
+        for (int ly = 0; ly < g_logical_h; ly++) for (int lx = 0; lx < g_logical_w; lx++) {
+            uint16_t want = src[(size_t)ly * g_logical_w + lx];
+            uint16_t got = dst[ref_rotate_offset(rot, g_logical_w, g_logical_h, lx, ly)];
+            if (got != want) fail(what, lx, ly, got, want);
+        }
+
+        // remainder paths: logical width/height and band not multiples of ROTATE_BLOCK
+        int lw = g_logical_w - 3, lh = g_logical_h - 5;
+        g_logical_w = lw; g_logical_h = lh;
+        fill_random(src, (size_t)lw * lh);
+        memset(dst, 0, FRAME_BYTES);
+        for (int ly = 0; ly < lh; ) {
+            int n = 1 + rnd16() % (2 * ROTATE_BAND);
+            if (n > lh - ly) n = lh - ly;
+            rotate_band(src + (size_t)ly * lw, ly, n, dst);
+            ly += n;
+        }
+        snprintf(what, sizeof(what), "rotate_band %d (%dx%d, uneven bands)", rot, lw, lh);
+        for (int ly = 0; ly < lh; ly++) for (int lx = 0; lx < lw; lx++) {
+            uint16_t want = src[(size_t)ly * lw + lx];
+            uint16_t got = dst[ref_rotate_offset(rot, lw, lh, lx, ly)];
+            if (got != want) fail(what, lx, ly, got, want);
+        }
+    }
+    rotation_init(0);
+}
+
+/* ---------- resampling ---------- */
+
+static void unpack565(uint16_t p, uint32_t *r, uint32_t *g, uint32_t *b) {
+    *r = p >> 11; *g = (p >> 5) & 0x3F; *b = p & 0x1F;
+}
+
+/* centre aligned source position of output o in SCALE_ONE units (bilinear), clamped like the tables */
+static void ref_bilinear_pos(int o, int src, int dst, int *i, uint32_t *f) {
+    int64_t pos = ((int64_t)(2*o + 1) * src * SCALE_ONE) / (2 * dst) - SCALE_ONE/2;
+    if (pos < 0) pos = 0;
+    *i = (int)(pos >> SCALE_FRAC_BITS);
+    *f = (uint32_t)(pos & (SCALE_ONE - 1));
+    if (*i >= src - 1) { *i = src - 2; *f = SCALE_ONE; }
+}
+
+static uint16_t ref_scale_pixel(const scaler_t *s, const uint16_t *src, int ox, int oy) {
+    const int sw = s->src_w, sh = s->src_h, dw = s->dst_w, dh = s->dst_h;
+    if (s->mode == SCALE_NEAREST) {
+        int sx = (int)(((int64_t)(2*ox + 1) * sw) / (2 * dw));
+        int sy = (int)(((int64_t)(2*oy + 1) * sh) / (2 * dh));
+        return src[(size_t)sy * sw + sx];
+    }
+    if (s->mode == SCALE_BOX) {
+        // exact average over the box, rounded
+        int x0 = (int)(((int64_t)ox * sw) / dw), x1 = (int)(((int64_t)(ox + 1) * sw) / dw);
+        int y0 = (int)(((int64_t)oy * sh) / dh), y1 = (int)(((int64_t)(oy + 1) * sh) / dh);
+        uint32_t sr = 0, sg = 0, sb = 0, n = (uint32_t)((x1 - x0) * (y1 - y0));
+        for (int y = y0; y < y1; y++) for (int x = x0; x < x1; x++) {
+            uint32_t r, g, b;
+            unpack565(src[(size_t)y * sw + x], &r, &g, &b);
+            sr += r; sg += g; sb += b;
+        }
+        return (uint16_t)((((sr + n/2) / n) << 11) | (((sg + n/2) / n) << 5) | ((sb + n/2) / n));
+    }
+    int ix, iy; uint32_t fx, fy;
+    ref_bilinear_pos(ox, sw, dw, &ix, &fx);
+    ref_bilinear_pos(oy, sh, dh, &iy, &fy);
+    uint32_t c[4][3];
+    for (int k = 0; k < 4; k++)
+        unpack565(src[(size_t)(iy + (k >> 1)) * sw + ix + (k & 1)], &c[k][0], &c[k][1], &c[k][2]);
+    uint32_t out[3];
+    for (int ch = 0; ch < 3; ch++) {
+        // vertical first, then horizontal, both in SCALE_FRAC_BITS fixed point
+        uint32_t left  = c[0][ch] * (SCALE_ONE - fy) + c[2][ch] * fy;
+        uint32_t right = c[1][ch] * (SCALE_ONE - fy) + c[3][ch] * fy;
+        out[ch] = (left * (SCALE_ONE - fx) + right * fx + (1u << (2*SCALE_FRAC_BITS - 1))) >> (2*SCALE_FRAC_BITS);
+    }
+    return (uint16_t)((out[0] << 11) | (out[1] << 5) | out[2]);
+}
+
+/* box uses Q16 reciprocals instead of a division: allow 1 step per channel */
+static int close565(uint16_t a, uint16_t b, int tol) {
+    uint32_t ar, ag, ab, br, bg, bb;
+    unpack565(a, &ar, &ag, &ab);
+    unpack565(b, &br, &bg, &bb);
+    return abs((int)ar - (int)br) <= tol && abs((int)ag - (int)bg) <= tol && abs((int)ab - (int)bb) <= tol;
+}
+
+static void check_scaler(uint16_t *dst) {
+    static const struct { int w, h; } sizes[] = {
+        { 1920, 1080 }, { 1280, 720 }, { 640, 480 }, { 320, 240 }, { 61, 61 }, { 1000, 300 },
+        { 123, 457 }, { 801, 479 }, { 4096, 61 },
+    };
+    static const int modes[] = { SCALE_NEAREST, SCALE_BILINEAR, SCALE_BOX };
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        int sw = sizes[k].w, sh = sizes[k].h;
+        uint16_t *src = (uint16_t*)malloc((size_t)sw * sh * sizeof(uint16_t));
+        if (!src) { fprintf(stderr, "out of memory\n"); exit(2); }
+        fill_random(src, (size_t)sw * sh);
+        for (int m = 0; m < 3; m++) {
+            scaler_t s;
+            if (scaler_init(&s, sw, sh, WIDTH, HEIGHT, modes[m]) != 0) { fprintf(stderr, "scaler_init failed\n"); exit(2); }
+            // a few row ranges, like the rotation bands use them
+            for (int y = 0; y < HEIGHT; ) {
+                int n = 1 + rnd16() % 40;
+                if (n > HEIGHT - y) n = HEIGHT - y;
+                scaler_rows(&s, src, y, y + n, dst + (size_t)y * WIDTH);
+                y += n;
+            }
+            char what[64];
+            snprintf(what, sizeof(what), "scaler %s %dx%d", scale_mode_name(s.mode), sw, sh);
+            int tol = s.mode == SCALE_BOX ? 1 : 0;
+            for (int y = 0; y < HEIGHT; y++) for (int x = 0; x < WIDTH; x++) {
+                int ox = x - s.dst_x, oy = y - s.dst_y;
+                uint16_t want = (ox < 0 || oy < 0 || ox >= s.dst_w || oy >= s.dst_h)
+                              ? COLOR_BG : ref_scale_pixel(&s, src, ox, oy);
+                uint16_t got = dst[(size_t)y * WIDTH + x];
+                if (!close565(got, want, tol)) fail(what, x, y, got, want);
+            }
+            scaler_free(&s);
+        }
+        free(src);
+    }
+}
+
+/* scaler + rotation together, as present_frame() fuses them */
+static void check_scaled_rotation(uint16_t *dst, uint16_t *ref) {
+    const int sw = 1280, sh = 720;
+    uint16_t *src = (uint16_t*)malloc((size_t)sw * sh * sizeof(uint16_t));
+    if (!src) { fprintf(stderr, "out of memory\n"); exit(2); }
+    fill_random(src, (size_t)sw * sh);
+    static const int rots[] = { 90, 270 };
+    for (int k = 0; k < 2; k++) {
+        rotation_init(rots[k]);
+        scaler_init(&g_scaler, sw, sh, g_logical_w, g_logical_h, SCALE_BILINEAR);
+        g_canvas = (canvas_t){ src, sw, sh };
+        present_frame(dst);
+        scaler_rows(&g_scaler, src, 0, g_logical_h, ref);   // unrotated logical frame
+        char what[64];
+        snprintf(what, sizeof(what), "present_frame scaled + rotate %d", rots[k]);
+        for (int ly = 0; ly < g_logical_h; ly++) for (int lx = 0; lx < g_logical_w; lx++) {
+            uint16_t want = ref[(size_t)ly * g_logical_w + lx];
+            uint16_t got = dst[ref_rotate_offset(rots[k], g_logical_w, g_logical_h, lx, ly)];
+            if (got != want) fail(what, lx, ly, got, want);
+        }
+        scaler_free(&g_scaler);
+    }
+    rotation_init(0);
+    free(src);
+}
+
+/* ---------- content keys ---------- */
+
+static void key_differs(const char *what, uint64_t a, uint64_t b) {
+    if (failures++ < 10) fprintf(stderr, "FAIL %s: same key %016llx\n", what, (unsigned long long)a);
+    (void)b;
+}
+#define EXPECT_KEY_NE(what, a, b) do { if ((a) == (b)) key_differs(what, a, b); } while (0)
+#define EXPECT_KEY_EQ(what, a, b) do { if ((a) != (b)) { \
+    if (failures++ < 10) fprintf(stderr, "FAIL %s: keys differ\n", what); } } while (0)
+
+/* moved or swapped stripes of a buffer must change the hash */
+static void check_hash_positions(void) {
+    enum { N = 4096 };
+    static uint8_t buf[N], tmp[N];
+    fill_random((uint16_t*)buf, N / 2);
+    uint64_t h = frame_hash64(buf, N, 0);
+    for (int k = 0; k < 200; k++) {
+        int s1 = rnd16() % (N / 64), s2 = rnd16() % (N / 64);
+        if (s1 == s2 || memcmp(buf + s1 * 64, buf + s2 * 64, 64) == 0) continue;
+        memcpy(tmp, buf, N);
+        memcpy(tmp + s1 * 64, buf + s2 * 64, 64);
+        memcpy(tmp + s2 * 64, buf + s1 * 64, 64);
+        EXPECT_KEY_NE("frame_hash64 swapped stripes", h, frame_hash64(tmp, N, 0));
+    }
+    // periodic background with one object, moved by whole stripes
+    static const int shifts[] = { 32, 64, 160, 320, 1024 };
+    for (size_t k = 0; k < sizeof(shifts) / sizeof(shifts[0]); k++) {
+        for (int i = 0; i < N; i++) buf[i] = (uint8_t)(i % 80);
+        memcpy(tmp, buf, N);
+        memset(buf + 100, 0xEE, 40);
+        memset(tmp + 100 + shifts[k], 0xEE, 40);
+        EXPECT_KEY_NE("frame_hash64 object shifted on a periodic background",
+                      frame_hash64(buf, N, 0), frame_hash64(tmp, N, 0));
+    }
+}
+
+static uint64_t scene_key(int rx, int ry, int cx, int cy, uint64_t *content) {
+    compositor_move_sprite(SPRITE_RECT, rx, ry, 1);
+    compositor_move_sprite(SPRITE_CURSOR, cx, cy, 1);
+    compositor_compose();
+    return canvas_key(content);
+}
+
+/*
+ * Demo scene: the background repeats every 40 px, so a sprite moved by a multiple of 160 px
+ * (five 32 pixel stripes) sits on identical background. Keys must still follow the position.
+ */
+static void check_scene_keys(int w, int h) {
+    uint16_t *px = (uint16_t*)malloc((size_t)w * h * sizeof(uint16_t));
+    if (!px) { fprintf(stderr, "out of memory\n"); exit(2); }
+    g_canvas = (canvas_t){ px, w, h };
+    if (demo_scene_init() != 0 || canvas_key_init() != 0) { fprintf(stderr, "scene init failed\n"); exit(2); }
+    dashboard_bind_key();
+    char what[96];
+    uint64_t c0, c1, c2;
+    uint64_t k0 = scene_key(10, 100, 20, 300, &c0);
+    uint64_t k1 = scene_key(170, 100, 20, 300, &c1);
+    snprintf(what, sizeof(what), "%dx%d rectangle x 10 -> 170", w, h);
+    EXPECT_KEY_NE(what, k0, k1);
+    EXPECT_KEY_NE(what, c0, c1);
+    uint64_t k2 = scene_key(10, 100, 180, 300, &c2);
+    snprintf(what, sizeof(what), "%dx%d cursor x 20 -> 180", w, h);
+    EXPECT_KEY_NE(what, k0, k2);
+    EXPECT_KEY_NE(what, c0, c2);
+    uint64_t k3 = scene_key(10, 140, 20, 300, NULL);
+    snprintf(what, sizeof(what), "%dx%d rectangle y 100 -> 140", w, h);
+    EXPECT_KEY_NE(what, k0, k3);
+    uint64_t c4, k4 = scene_key(10, 100, 20, 300, &c4);
+    snprintf(what, sizeof(what), "%dx%d same scene again", w, h);
+    EXPECT_KEY_EQ(what, k0, k4);
+    EXPECT_KEY_EQ(what, c0, c4);
+
+    // a grid row and a plain row 8 apart swapped (8 rows: one stripe of the row-hash table)
+    uint16_t *a = px + (size_t)40 * w, *b = px + (size_t)48 * w;
+    for (int x = 0; x < w; x++) { uint16_t t = a[x]; a[x] = b[x]; b[x] = t; }
+    canvas_key_invalidate(40, 49);
+    uint64_t c5, k5 = canvas_key(&c5);
+    snprintf(what, sizeof(what), "%dx%d rows 40 and 48 swapped", w, h);
+    EXPECT_KEY_NE(what, k0, k5);
+    EXPECT_KEY_NE(what, c0, c5);
+
+    canvas_key_free();
+    glyph_atlas_cache_free();
+    compositor_free();
+    memset(&g_dash, 0, sizeof(g_dash));
+    free(px);
+}
+
+/* ---------- compositor ---------- */
+
+/* reference: one pixel, channel by channel, alpha rounded to 5 bits like blend565_span() */
+static uint16_t ref_blend565(uint16_t d, uint16_t s, uint8_t a) {
+    unsigned al = ((unsigned)a + 4) >> 3;
+    unsigned r = (((unsigned)s >> 11) * al + ((unsigned)d >> 11) * (32 - al)) >> 5;
+    unsigned g = ((((unsigned)s >> 5) & 0x3F) * al + (((unsigned)d >> 5) & 0x3F) * (32 - al)) >> 5;
+    unsigned b = (((unsigned)s & 0x1F) * al + ((unsigned)d & 0x1F) * (32 - al)) >> 5;
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+/* random spans at random offsets (vector body and tail), every alpha value */
+static void check_blend565(void) {
+    enum { N = 300 };
+    uint16_t d[N], s[N], want[N];
+    uint8_t a[N];
+    for (int iter = 0; iter < 2000; iter++) {
+        int off = rnd16() % 16, n = 1 + rnd16() % (N - 16);
+        fill_random(d, N);
+        fill_random(s, N);
+        for (int i = 0; i < N; i++) a[i] = (uint8_t)(iter < 256 ? iter : rnd16());
+        for (int i = 0; i < N; i++) want[i] = i >= off && i < off + n ? ref_blend565(d[i], s[i], a[i]) : d[i];
+        blend565_span(d + off, s + off, a + off, n);
+        for (int i = 0; i < N; i++)
+            if (d[i] != want[i]) { fail("blend565_span", i, iter, d[i], want[i]); break; }
+    }
+}
+
+/* canvas pixel straight from the layers and sprites, no static_comp and no damage tracking */
+static uint16_t ref_compose_pixel(int x, int y) {
+    const compositor_t *c = &g_comp;
+    size_t o = (size_t)y * c->w + x;
+    uint16_t v = c->layers[LAYER_BACKGROUND].px[o];
+    v = ref_blend565(v, c->layers[LAYER_WIDGETS].px[o], c->layers[LAYER_WIDGETS].alpha[o]);
+    v = ref_blend565(v, c->layers[LAYER_TEXT].px[o], c->layers[LAYER_TEXT].alpha[o]);
+    for (int i = 0; i < SPRITE_COUNT; i++) {
+        const sprite_t *s = &c->sprites[i];
+        if (!s->visible || x < s->x || x >= s->x + s->w || y < s->y || y >= s->y + s->h) continue;
+        size_t so = (size_t)(y - s->y) * s->w + (x - s->x);
+        v = ref_blend565(v, s->px[so], s->alpha[so]);
+    }
+    return v;
+}
+
+/*
+ * Demo scene with random sprite moves (partly off the canvas, hidden/shown) and label updates.
+ * After every incremental compositor_compose() the canvas must equal a forced full redraw;
+ * every few steps both are also checked against the per pixel reference.
+ */
+static void check_compositor(int w, int h) {
+    static const char chars[] = "0123456789.,%-ABZ ";
+    uint16_t *px = (uint16_t*)malloc((size_t)w * h * sizeof(uint16_t));
+    uint16_t *full = (uint16_t*)malloc((size_t)w * h * sizeof(uint16_t));
+    if (!px || !full) { fprintf(stderr, "out of memory\n"); exit(2); }
+    g_canvas = (canvas_t){ px, w, h };
+    if (demo_scene_init() != 0) { fprintf(stderr, "scene init failed\n"); exit(2); }
+    char what[96];
+    for (int iter = 0; iter < 300; iter++) {
+        for (int i = 0; i < SPRITE_COUNT; i++) {
+            const sprite_t *s = &g_comp.sprites[i];
+            if (rnd16() % 4 == 0) continue;   // not moved this frame
+            int x = (int)(rnd16() % (w + s->w)) - s->w / 2, y = (int)(rnd16() % (h + s->h)) - s->h / 2;
+            compositor_move_sprite(i, x, y, rnd16() % 8 != 0);
+        }
+        int nl = rnd16() % 3;
+        for (int k = 0; k < nl; k++) {
+            char buf[TEXT_LABEL_MAX + 1];
+            int n = rnd16() % 9;
+            for (int i = 0; i < n; i++) buf[i] = chars[rnd16() % (sizeof(chars) - 1)];
+            buf[n] = '\0';
+            text_label_set(&g_dash.value[rnd16() % DASH_PANELS], buf);
+        }
+        compositor_compose();
+
+        g_canvas.px = full;
+        g_comp.full_redraw = 1;
+        compositor_compose();
+        g_canvas.px = px;
+        snprintf(what, sizeof(what), "%dx%d compose vs full redraw, step %d", w, h, iter);
+        for (size_t i = 0; i < (size_t)w * h; i++)
+            if (px[i] != full[i]) { fail(what, (int)(i % w), (int)(i / w), px[i], full[i]); break; }
+
+        if (iter % 10 != 9) continue;
+        snprintf(what, sizeof(what), "%dx%d full redraw vs reference, step %d", w, h, iter);
+        for (int y = 0; y < h; y++) for (int x = 0; x < w; x++) {
+            uint16_t want = ref_compose_pixel(x, y);
+            if (full[(size_t)y * w + x] != want) { fail(what, x, y, full[(size_t)y * w + x], want); y = h; break; }
+        }
+    }
+    glyph_atlas_cache_free();
+    compositor_free();
+    memset(&g_dash, 0, sizeof(g_dash));
+    free(px); free(full);
+}
+
+/* ---------- timing (--bench) ---------- */
+
+#define BENCH_RUNS 50
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* median of BENCH_RUNS calls, in microseconds */
+static double bench_median_us(void (*fn)(void *), void *arg) {
+    uint64_t t[BENCH_RUNS];
+    fn(arg);   // warm up: tables, caches, page faults
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        uint64_t t0 = now_ns();
+        fn(arg);
+        t[i] = now_ns() - t0;
+    }
+    qsort(t, BENCH_RUNS, sizeof(t[0]), cmp_u64);
+    return (double)t[BENCH_RUNS / 2] / 1000.0;
+}
+
+typedef struct { scaler_t *s; const uint16_t *src; uint16_t *dst; } bench_scale_t;
+
+static void bench_scale_frame(void *arg) {
+    bench_scale_t *b = (bench_scale_t*)arg;
+    scaler_rows(b->s, b->src, 0, b->s->out_h, b->dst);
+}
+
+static void bench_present(void *arg) {
+    present_frame((uint16_t*)arg);
+}
+
+static int run_bench(void) {
+    static const struct { int w, h; } sizes[] = { { 1280, 720 }, { 1024, 600 } };
+    static const int modes[] = { SCALE_NEAREST, SCALE_BILINEAR, SCALE_BOX };
+    uint16_t *dst = (uint16_t*)malloc(FRAME_BYTES);
+    if (!dst) { fprintf(stderr, "out of memory\n"); return 2; }
+    printf("scaler -> %dx%d, median of %d frames\n", WIDTH, HEIGHT, BENCH_RUNS);
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        int sw = sizes[k].w, sh = sizes[k].h;
+        uint16_t *src = (uint16_t*)malloc((size_t)sw * sh * sizeof(uint16_t));
+        if (!src) { fprintf(stderr, "out of memory\n"); return 2; }
+        fill_random(src, (size_t)sw * sh);
+        for (int m = 0; m < 3; m++) {
+            scaler_t s;
+            if (scaler_init(&s, sw, sh, WIDTH, HEIGHT, modes[m]) != 0) { fprintf(stderr, "scaler_init failed\n"); return 2; }
+            bench_scale_t b = { &s, src, dst };
+            double us = bench_median_us(bench_scale_frame, &b);
+            printf("  %4dx%-4d %-8s scale          %8.2f ms\n", sw, sh, scale_mode_name(s.mode), us / 1000.0);
+            scaler_free(&s);
+        }
+        // the live path: scaler fused with rotation, straight into the payload
+        for (int m = 0; m < 3; m++) {
+            rotation_init(90);
+            scaler_init(&g_scaler, sw, sh, g_logical_w, g_logical_h, modes[m]);
+            g_canvas = (canvas_t){ src, sw, sh };
+            double us = bench_median_us(bench_present, dst);
+            printf("  %4dx%-4d %-8s scale+rotate90 %8.2f ms\n", sw, sh, scale_mode_name(g_scaler.mode), us / 1000.0);
+            scaler_free(&g_scaler);
+            rotation_init(0);
+        }
+        free(src);
+    }
+    g_canvas = (canvas_t){ &framebuffer[0][0], WIDTH, HEIGHT };
+    free(dst);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) return run_bench();
+    uint16_t *a = (uint16_t*)malloc(FRAME_BYTES), *b = (uint16_t*)malloc(FRAME_BYTES);
+    if (!a || !b) { fprintf(stderr, "out of memory\n"); return 2; }
+    check_transpose();
+    check_rotation(a, b);
+    check_scaler(a);
+    check_scaled_rotation(a, b);
+    check_hash_positions();
+    check_scene_keys(WIDTH, HEIGHT);
+    check_scene_keys(1280, 720);
+    check_blend565();
+    check_compositor(WIDTH, HEIGHT);
+    check_compositor(1280, 720);
+    g_canvas = (canvas_t){ &framebuffer[0][0], WIDTH, HEIGHT };
+    free(a); free(b);
+    if (failures) { fprintf(stderr, "check_transform: %d mismatches\n", failures); return 1; }
+    printf("check_transform: transpose, rotation 90/180/270 and scaler nearest/bilinear/box, content keys, compositor OK\n");
+    return 0;
+}
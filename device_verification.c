@@ -1,6 +1,6 @@
 // ===== usb_touch_screen_libevdev_fixed_send_match_event.c =====
-// Key changes: added find_event_for_libusb_device() to match /dev/input/eventN
-// to the same physical USB device opened by libusb (by matching idVendor/idProduct and optional serial).
+// Demo client of libusbmonitor (usb_monitor.h): device connect, frame submission and touch input
+// live in the library; this file renders, caches, records and replays frames.
 
 #define _GNU_SOURCE
 #include <stdio.h>
@@ -15,10 +15,13 @@
 #include <errno.h>
 #include <signal.h>
 #include <limits.h>
-#include <libusb-1.0/libusb.h>
-#include <libevdev/libevdev.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-#include "usb_monitor_control.h"
+#include "usb_monitor.h"
+#define XXH_INLINE_ALL   // header only, lets gcc pick the NEON/SSE2 accumulate loop
+#include "xxhash.h"
 
 #define WIDTH   800
 #define HEIGHT  480
@@ -26,15 +29,14 @@
 #define RECT_H  60
 #define COLOR_RECT 0xF800
 #define COLOR_BG   0x0000
+#define FRAME_BYTES (WIDTH * HEIGHT * 2) // RGB565 = 2 bytes/pixel
 
-#define VENDOR_ID  0x1fc9
-#define PRODUCT_ID 0x8335
-#define EP_OUT     0x03
-#define PACKET_SIZE 1024
-
-#define USB_TOUCH_INTERFACE_NUM  0
-#define USB_SCREEN_INTERFACE_NUM 1
-#define TOUCH_EVENT_SCAN_MAX     64   // scan this many event nodes (0..63)
+#define FRAME_CACHE_MAX_ENTRIES  32                      // LRU slot 수 상한
+#define FRAME_CACHE_MAX_BYTES    (12u * 1024u * 1024u)   // 기본 payload 상한 (--cache-mb), usbfs_memory_mb 기본값 16MB보다 작게
+#define FRAME_CACHE_REPORT_US    10000000ULL             // hit rate/메모리 사용량 출력 주기
+#define FRAME_POOL_SCRATCH       2                       // bypass/replay frames outside the cache
+#define FRAME_POOL_FRAMES        (FRAME_CACHE_MAX_ENTRIES + FRAME_POOL_SCRATCH)   // library frame pool
+#define USBFS_MEMORY_MB_PATH     "/sys/module/usbcore/parameters/usbfs_memory_mb"
 
 #define AUTO_RANDOM_MOVE
 
@@ -43,43 +45,437 @@ static uint64_t last_user_input_us = 0;   // 마지막 실제 터치 시각
 static uint64_t last_auto_gen_us   = 0;   // 마지막 랜덤 타겟 생성 시각
 #endif
 
-static uint16_t framebuffer[HEIGHT][WIDTH];
+static uint16_t framebuffer[HEIGHT][WIDTH];   // canvas at panel resolution (no --source/--rotate)
+
+/* render target: framebuffer itself, or a source-resolution buffer when --source is used */
+typedef struct { uint16_t *px; int w, h; } canvas_t;
+static canvas_t g_canvas = { &framebuffer[0][0], WIDTH, HEIGHT };
 
-static inline void clear_framebuffer(void) {
-    for (int y=0;y<HEIGHT;y++) for (int x=0;x<WIDTH;x++) framebuffer[y][x]=COLOR_BG;
-}
 typedef struct { int x,y; } Rect;
-static inline void draw_rectangle(const Rect* r) {
-    for (int yy=0; yy<RECT_H; yy++){
-        int py = r->y + yy;
-        if (py<0 || py>=HEIGHT) continue;
-        for (int xx=0; xx<RECT_W; xx++){
-            int px = r->x + xx;
-            if (px<0 || px>=WIDTH) continue;
-            framebuffer[py][px]=COLOR_RECT;
-        }
-    }
-}
 static inline void clamp_rect(Rect *r){
     if (r->x < 0) r->x = 0;
     if (r->y < 0) r->y = 0;
-    if (r->x + RECT_W >= WIDTH)  r->x = WIDTH - RECT_W;
-    if (r->y + RECT_H >= HEIGHT) r->y = HEIGHT - RECT_H;
+    if (r->x + RECT_W >= g_canvas.w)  r->x = g_canvas.w - RECT_W;
+    if (r->y + RECT_H >= g_canvas.h) r->y = g_canvas.h - RECT_H;
 }
 
-/* libusb state */
-static libusb_context *ctx = NULL;
-static libusb_device_handle *handle = NULL;
-static int interface_claimed_screen = 0;
-static int kernel_attached_screen = 0;
+/* ---------- resampling stage (source canvas -> panel) ---------- */
+
+/*
+ * Producers render into g_canvas at their own resolution; scaler_rows() fits it onto the
+ * out_w x out_h panel (logical orientation, see rotation below) with aspect-preserving
+ * letterbox, a range of output rows at a time, writing straight into the transfer-ready buffer
+ * or into the band that the rotation stage consumes (no intermediate full frame).
+ *
+ * Separable fixed-point kernels (SCALE_FRAC_BITS fraction), one output row at a time so the
+ * working set (source rows + per-column scratch) stays in L1. Each kernel is split into a
+ * gather through the precomputed column table (scalar loads only) and a contiguous,
+ * element-wise loop over the output columns that gcc vectorizes for NEON/SSE2:
+ *  - bilinear: source pixels x and x+1 are adjacent, so one 32-bit load per source row fetches
+ *    both; the blend (vertical first, then horizontal) and the RGB565 pack run vectorized
+ *  - box: per-column sums over the box rows, packed R/G/B into one 64-bit word and turned
+ *    into prefix sums, so a box of any width is one subtraction; reciprocal multiply instead
+ *    of division
+ * Box filter is downscale only; it falls back to bilinear when either axis is upscaled.
+ * `make bench` reports the time per filter.
+ */
+#define SCALE_NEAREST   0
+#define SCALE_BILINEAR  1
+#define SCALE_BOX       2
+#define SCALE_FRAC_BITS 8
+#define SCALE_ONE       (1 << SCALE_FRAC_BITS)
+#define SCALE_MIN_DIM   16
+#define SCALE_MAX_DIM   4096
 
-/* libevdev touch */
-typedef struct { struct libevdev *dev; int fd; } touch_device_info_t;
-static touch_device_info_t touch_info = { NULL, -1 };
 typedef struct {
-    int have_mt, have_st;
-    int abs_min_x, abs_max_x;
-    int abs_min_y, abs_max_y;
+    int active;
+    int mode;
+    int src_w, src_h;
+    int out_w, out_h;                   // output frame (logical panel)
+    int dst_x, dst_y, dst_w, dst_h;     // letterboxed placement inside the output
+    int32_t  *x_idx;  uint16_t *x_frac; // per output column (box: dst_w+1 boundaries)
+    int32_t  *y_idx;  uint16_t *y_frac; // per output row    (box: dst_h+1 boundaries)
+    uint32_t *x_recip, *y_recip;        // box: Q16 reciprocal of box width/height
+    uint16_t *tap[2];                   // bilinear: source pixels x, x+1 per output column, rows a and b
+    uint64_t *colsum;                   // box: packed column sums, then prefix sums (src_w+1)
+    uint64_t *boxsum;                   // box: packed box sums per output column
+} scaler_t;
+static scaler_t g_scaler;
+
+static const char *scale_mode_name(int mode) {
+    return mode == SCALE_NEAREST ? "nearest" : mode == SCALE_BOX ? "box" : "bilinear";
+}
+
+static void scaler_free(scaler_t *s) {
+    free(s->x_idx); free(s->x_frac); free(s->y_idx); free(s->y_frac);
+    free(s->x_recip); free(s->y_recip);
+    free(s->tap[0]); free(s->tap[1]);
+    free(s->colsum); free(s->boxsum);
+    memset(s, 0, sizeof(*s));
+}
+
+/* bilinear / nearest column (or row) table, centre aligned */
+static void scaler_build_axis(int mode, int src, int dst, int32_t *idx, uint16_t *frac) {
+    for (int o = 0; o < dst; o++) {
+        if (mode == SCALE_NEAREST) {
+            idx[o] = (int32_t)(((int64_t)(2*o + 1) * src) / (2 * dst));
+            frac[o] = 0;
+            continue;
+        }
+        int64_t pos = ((int64_t)(2*o + 1) * src * SCALE_ONE) / (2 * dst) - SCALE_ONE/2;
+        if (pos < 0) pos = 0;
+        int32_t i = (int32_t)(pos >> SCALE_FRAC_BITS);
+        uint16_t f = (uint16_t)(pos & (SCALE_ONE - 1));
+        if (i >= src - 1) { i = src - 2; f = SCALE_ONE; }
+        idx[o] = i; frac[o] = f;
+    }
+}
+
+/* box boundaries: output o covers source [idx[o], idx[o+1]) */
+static void scaler_build_box_axis(int src, int dst, int32_t *idx, uint32_t *recip) {
+    for (int o = 0; o <= dst; o++) idx[o] = (int32_t)(((int64_t)o * src) / dst);
+    for (int o = 0; o < dst; o++) recip[o] = 65536u / (uint32_t)(idx[o+1] - idx[o]);
+}
+
+static int scaler_init(scaler_t *s, int src_w, int src_h, int out_w, int out_h, int mode) {
+    memset(s, 0, sizeof(*s));
+    s->src_w = src_w; s->src_h = src_h;
+    s->out_w = out_w; s->out_h = out_h;
+    // aspect-preserving fit
+    if ((int64_t)src_w * out_h >= (int64_t)src_h * out_w) {
+        s->dst_w = out_w;
+        s->dst_h = (int)(((int64_t)src_h * out_w + src_w/2) / src_w);
+    } else {
+        s->dst_h = out_h;
+        s->dst_w = (int)(((int64_t)src_w * out_h + src_h/2) / src_h);
+    }
+    if (s->dst_w < 1) s->dst_w = 1;
+    if (s->dst_h < 1) s->dst_h = 1;
+    s->dst_x = (out_w - s->dst_w) / 2;
+    s->dst_y = (out_h - s->dst_h) / 2;
+    if (mode == SCALE_BOX && (src_w < s->dst_w || src_h < s->dst_h)) {
+        fprintf(stderr, "box filter is downscale only; using bilinear for %dx%d\n", src_w, src_h);
+        mode = SCALE_BILINEAR;
+    }
+    s->mode = mode;
+
+    s->x_idx  = (int32_t*)calloc((size_t)s->dst_w + 1, sizeof(int32_t));
+    s->y_idx  = (int32_t*)calloc((size_t)s->dst_h + 1, sizeof(int32_t));
+    s->x_frac = (uint16_t*)calloc((size_t)s->dst_w, sizeof(uint16_t));
+    s->y_frac = (uint16_t*)calloc((size_t)s->dst_h, sizeof(uint16_t));
+    s->x_recip = (uint32_t*)calloc((size_t)s->dst_w, sizeof(uint32_t));
+    s->y_recip = (uint32_t*)calloc((size_t)s->dst_h, sizeof(uint32_t));
+    int oom = 0;
+    for (int k = 0; k < 2; k++) {
+        s->tap[k] = (uint16_t*)calloc((size_t)s->dst_w * 2, sizeof(uint16_t));
+        if (!s->tap[k]) oom = 1;
+    }
+    s->colsum = (uint64_t*)calloc((size_t)src_w + 1, sizeof(uint64_t));
+    s->boxsum = (uint64_t*)calloc((size_t)s->dst_w, sizeof(uint64_t));
+    if (!s->x_idx || !s->y_idx || !s->x_frac || !s->y_frac || !s->x_recip || !s->y_recip ||
+        !s->colsum || !s->boxsum) oom = 1;
+    if (oom) { scaler_free(s); return -1; }
+
+    if (mode == SCALE_BOX) {
+        scaler_build_box_axis(src_w, s->dst_w, s->x_idx, s->x_recip);
+        scaler_build_box_axis(src_h, s->dst_h, s->y_idx, s->y_recip);
+    } else {
+        scaler_build_axis(mode, src_w, s->dst_w, s->x_idx, s->x_frac);
+        scaler_build_axis(mode, src_h, s->dst_h, s->y_idx, s->y_frac);
+    }
+    s->active = 1;
+    return 0;
+}
+
+/* one output row from source rows a, b (b = a + 1 row) */
+static void scaler_row_bilinear(scaler_t *s, const uint16_t *a, const uint16_t *b, uint16_t fy,
+                                uint16_t *restrict out) {
+    uint16_t *restrict ta = s->tap[0], *restrict tb = s->tap[1];
+    const int32_t *restrict xi = s->x_idx;
+    const int w = s->dst_w;
+    // gather: pixels x and x+1 are adjacent, one 32-bit copy per row fetches both taps
+    for (int ox = 0; ox < w; ox++) {
+        memcpy(ta + 2*ox, a + xi[ox], 2 * sizeof(uint16_t));
+        memcpy(tb + 2*ox, b + xi[ox], 2 * sizeof(uint16_t));
+    }
+    /*
+     * blend, vectorized (interleaved taps -> NEON ld2 / SSE2 shuffles): vertical in 16 bit lanes
+     * (a channel times SCALE_ONE fits), then the horizontal widening multiply, both in
+     * SCALE_FRAC_BITS fixed point
+     */
+    const uint16_t *restrict fx = s->x_frac;
+    const uint16_t f0y = (uint16_t)(SCALE_ONE - fy);
+    const uint32_t half = 1u << (2*SCALE_FRAC_BITS - 1);
+    for (int ox = 0; ox < w; ox++) {
+        const uint16_t p0 = ta[2*ox], p1 = ta[2*ox+1], q0 = tb[2*ox], q1 = tb[2*ox+1];
+        const uint16_t f1 = fx[ox], f0 = (uint16_t)(SCALE_ONE - f1);
+        uint16_t lr = (uint16_t)((p0 >> 11) * f0y + (q0 >> 11) * fy);
+        uint16_t rr = (uint16_t)((p1 >> 11) * f0y + (q1 >> 11) * fy);
+        uint16_t lg = (uint16_t)(((p0 >> 5) & 0x3F) * f0y + ((q0 >> 5) & 0x3F) * fy);
+        uint16_t rg = (uint16_t)(((p1 >> 5) & 0x3F) * f0y + ((q1 >> 5) & 0x3F) * fy);
+        uint16_t lb = (uint16_t)((p0 & 0x1F) * f0y + (q0 & 0x1F) * fy);
+        uint16_t rb = (uint16_t)((p1 & 0x1F) * f0y + (q1 & 0x1F) * fy);
+        uint32_t cr = ((uint32_t)lr * f0 + (uint32_t)rr * f1 + half) >> (2*SCALE_FRAC_BITS);
+        uint32_t cg = ((uint32_t)lg * f0 + (uint32_t)rg * f1 + half) >> (2*SCALE_FRAC_BITS);
+        uint32_t cb = ((uint32_t)lb * f0 + (uint32_t)rb * f1 + half) >> (2*SCALE_FRAC_BITS);
+        out[ox] = (uint16_t)((cr << 11) | (cg << 5) | cb);
+    }
+}
+
+/*
+ * box sums are packed as r | g << 21 | b << 42. Packing is linear, so the difference of two
+ * prefix sums is the packed box sum even though the prefix fields overflow into each other;
+ * a box sum itself (at most 16x16 pixels of 63) fits its 21 bit field.
+ */
+#define BOX_FIELD_BITS 21
+#define BOX_FIELD_MASK ((1u << BOX_FIELD_BITS) - 1)
+
+static void scaler_row_box(scaler_t *s, const uint16_t *src, int oy, uint16_t *restrict out) {
+    uint64_t *restrict cs = s->colsum;
+    const int w = s->src_w;
+    // vertical sums of the box rows into cs[1..w] (contiguous, vectorized)
+    memset(cs, 0, ((size_t)w + 1) * sizeof(uint64_t));
+    for (int y = s->y_idx[oy]; y < s->y_idx[oy+1]; y++) {
+        const uint16_t *restrict row = src + (size_t)y * w;
+        for (int x = 0; x < w; x++) {
+            uint64_t p = row[x];
+            cs[x+1] += (p >> 11) | (((p >> 5) & 0x3F) << BOX_FIELD_BITS) | ((p & 0x1F) << (2*BOX_FIELD_BITS));
+        }
+    }
+    for (int x = 1; x <= w; x++) cs[x] += cs[x-1];
+    // horizontal box sums: one subtraction per output column
+    uint64_t *restrict bs = s->boxsum;
+    const int32_t *restrict xi = s->x_idx;
+    for (int ox = 0; ox < s->dst_w; ox++) bs[ox] = cs[xi[ox+1]] - cs[xi[ox]];
+    // scale by 1/(box_w*box_h) with two Q16 reciprocals (vectorized)
+    const uint32_t *restrict rxs = s->x_recip;
+    const uint32_t ry = s->y_recip[oy];
+    const uint32_t half = 1u << (32 - SCALE_FRAC_BITS - 1);
+    for (int ox = 0; ox < s->dst_w; ox++) {
+        uint64_t v = bs[ox];
+        uint32_t sr = (uint32_t)v & BOX_FIELD_MASK;
+        uint32_t sg = (uint32_t)(v >> BOX_FIELD_BITS) & BOX_FIELD_MASK;
+        uint32_t sb = (uint32_t)(v >> (2*BOX_FIELD_BITS));
+        const uint32_t rx = rxs[ox];
+        uint32_t cr = (((sr * rx) >> SCALE_FRAC_BITS) * ry + half) >> (32 - SCALE_FRAC_BITS);
+        uint32_t cg = (((sg * rx) >> SCALE_FRAC_BITS) * ry + half) >> (32 - SCALE_FRAC_BITS);
+        uint32_t cb = (((sb * rx) >> SCALE_FRAC_BITS) * ry + half) >> (32 - SCALE_FRAC_BITS);
+        out[ox] = (uint16_t)((cr << 11) | (cg << 5) | cb);
+    }
+}
+
+static inline void fill565(uint16_t *p, int n, uint16_t c) {
+    for (int i = 0; i < n; i++) p[i] = c;
+}
+
+/* output rows [y0, y1) of the fitted frame; dst points at row y0, stride out_w */
+static void scaler_rows(scaler_t *s, const uint16_t *src, int y0, int y1, uint16_t *dst) {
+    for (int y = y0; y < y1; y++) {
+        uint16_t *line = dst + (size_t)(y - y0) * s->out_w;
+        int oy = y - s->dst_y;
+        // letterbox bars (slot payloads are reused, so they are written every time)
+        if (oy < 0 || oy >= s->dst_h) { fill565(line, s->out_w, COLOR_BG); continue; }
+        fill565(line, s->dst_x, COLOR_BG);
+        fill565(line + s->dst_x + s->dst_w, s->out_w - s->dst_x - s->dst_w, COLOR_BG);
+        uint16_t *out = line + s->dst_x;
+        switch (s->mode) {
+        case SCALE_NEAREST: {
+            if (y > y0 && oy > 0 && s->y_idx[oy] == s->y_idx[oy-1]) { memcpy(out, out - s->out_w, (size_t)s->dst_w * 2); break; }
+            const uint16_t *row = src + (size_t)s->y_idx[oy] * s->src_w;
+            for (int ox = 0; ox < s->dst_w; ox++) out[ox] = row[s->x_idx[ox]];
+            break;
+        }
+        case SCALE_BOX:
+            scaler_row_box(s, src, oy, out);
+            break;
+        default: {
+            const uint16_t *a = src + (size_t)s->y_idx[oy] * s->src_w;
+            scaler_row_bilinear(s, a, a + s->src_w, s->y_frac[oy], out);
+            break;
+        }
+        }
+    }
+}
+
+/* output rows [*o0, *o1) whose filter footprint touches source rows [y0, y1) */
+static void scaler_source_rows_to_output(const scaler_t *s, int y0, int y1, int *o0, int *o1) {
+    *o0 = *o1 = 0;
+    for (int oy = 0; oy < s->dst_h; oy++) {
+        int lo = s->y_idx[oy];
+        int hi = s->mode == SCALE_BOX ? s->y_idx[oy+1] : s->mode == SCALE_NEAREST ? lo + 1 : lo + 2;
+        if (hi <= y0 || lo >= y1) continue;
+        if (*o0 == *o1) *o0 = s->dst_y + oy;
+        *o1 = s->dst_y + oy + 1;
+    }
+}
+
+/* logical panel coordinate -> canvas coordinate (inverse of the letterbox fit) */
+static inline void scaler_panel_to_source(const scaler_t *s, int *x, int *y) {
+    if (!s->active) return;
+    int sx = (int)(((int64_t)(2*(*x - s->dst_x) + 1) * s->src_w) / (2 * s->dst_w));
+    int sy = (int)(((int64_t)(2*(*y - s->dst_y) + 1) * s->src_h) / (2 * s->dst_h));
+    if (sx < 0) sx = 0; else if (sx >= s->src_w) sx = s->src_w - 1;
+    if (sy < 0) sy = 0; else if (sy >= s->src_h) sy = s->src_h - 1;
+    *x = sx; *y = sy;
+}
+
+/* ---------- panel rotation (fused into the write of the transfer buffer) ---------- */
+
+/*
+ * g_rotation degrees clockwise: the logical frame (g_logical_w x g_logical_h, portrait for
+ * 90/270) is turned by that much onto the WIDTH x HEIGHT panel.
+ *   90 : logical (lx,ly) -> panel (LH-1-ly, lx)
+ *   180: logical (lx,ly) -> panel (LW-1-lx, LH-1-ly)
+ *   270: logical (lx,ly) -> panel (ly, LW-1-lx)
+ * present_frame() walks the logical frame in bands of ROTATE_BAND rows: each band is produced
+ * by the scaler (or read straight from the canvas) and rotated into the payload while it is
+ * still in cache, so rotation costs no extra full-frame pass. 90/270 use 8x8 register
+ * transposes (gcc vector extensions -> NEON zip/trn or SSE2 punpck); a 32-row band writes
+ * whole 64-byte lines of the destination.
+ */
+#define ROTATE_BAND 32
+#define ROTATE_BLOCK 8
+
+static int g_rotation = 0;
+static int g_logical_w = WIDTH, g_logical_h = HEIGHT;
+static uint16_t rotate_band_buf[ROTATE_BAND * (WIDTH > HEIGHT ? WIDTH : HEIGHT)];
+
+typedef uint16_t v8u16 __attribute__((vector_size(16)));
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+typedef uint64_t v2u64 __attribute__((vector_size(16)));
+
+/* r[i] = row i of an 8x8 block -> r[j] = column j */
+static inline void transpose8x8_u16(v8u16 r[8]) {
+    v8u16 t[8];
+    for (int i = 0; i < 8; i += 2) {
+        t[i]   = __builtin_shuffle(r[i], r[i+1], (v8u16){0, 8, 1, 9, 2, 10, 3, 11});
+        t[i+1] = __builtin_shuffle(r[i], r[i+1], (v8u16){4, 12, 5, 13, 6, 14, 7, 15});
+    }
+    v4u32 u[8];
+    for (int i = 0; i < 8; i += 4) {
+        for (int k = 0; k < 2; k++) {
+            v4u32 a = (v4u32)t[i+k], b = (v4u32)t[i+k+2];
+            u[i+2*k]   = __builtin_shuffle(a, b, (v4u32){0, 4, 1, 5});
+            u[i+2*k+1] = __builtin_shuffle(a, b, (v4u32){2, 6, 3, 7});
+        }
+    }
+    for (int k = 0; k < 4; k++) {
+        v2u64 a = (v2u64)u[k], b = (v2u64)u[k+4];
+        r[2*k]   = (v8u16)__builtin_shuffle(a, b, (v2u64){0, 2});
+        r[2*k+1] = (v8u16)__builtin_shuffle(a, b, (v2u64){1, 3});
+    }
+}
+
+/*
+ * rotate logical rows [ly0, ly0+n) (src, stride g_logical_w) into the panel frame dst.
+ * band edges not multiple of ROTATE_BLOCK fall back to the per pixel mapping.
+ */
+static void rotate_band(const uint16_t *src, int ly0, int n, uint16_t *dst) {
+    const int lw = g_logical_w, lh = g_logical_h;
+    if (g_rotation == 180) {
+        for (int i = 0; i < n; i++) {
+            const uint16_t *restrict s = src + (size_t)i * lw;
+            uint16_t *restrict d = dst + (size_t)(lh - 1 - (ly0 + i)) * WIDTH + (lw - 1);
+            for (int x = 0; x < lw; x++) d[-x] = s[x];
+        }
+        return;
+    }
+    const int nb = n - n % ROTATE_BLOCK, wb = lw - lw % ROTATE_BLOCK;
+    for (int i = 0; i < nb; i += ROTATE_BLOCK) {
+        const int ly = ly0 + i;
+        for (int lx = 0; lx < wb; lx += ROTATE_BLOCK) {
+            v8u16 r[8];
+            if (g_rotation == 90) {
+                // rows loaded bottom-up so each transposed row runs left to right on the panel
+                for (int k = 0; k < 8; k++) memcpy(&r[k], src + (size_t)(i + 7 - k) * lw + lx, 16);
+                transpose8x8_u16(r);
+                uint16_t *d = dst + (size_t)lx * WIDTH + (lh - 8 - ly);
+                for (int k = 0; k < 8; k++) memcpy(d + (size_t)k * WIDTH, &r[k], 16);
+            } else {
+                for (int k = 0; k < 8; k++) memcpy(&r[k], src + (size_t)(i + k) * lw + lx, 16);
+                transpose8x8_u16(r);
+                uint16_t *d = dst + (size_t)(lw - 1 - lx) * WIDTH + ly;
+                for (int k = 0; k < 8; k++) memcpy(d - (size_t)k * WIDTH, &r[k], 16);
+            }
+        }
+    }
+    // remainders (not hit for the 800x480 panel)
+    for (int i = 0; i < n; i++) {
+        const int ly = ly0 + i;
+        for (int lx = (i < nb ? wb : 0); lx < lw; lx++) {
+            uint16_t p = src[(size_t)i * lw + lx];
+            if (g_rotation == 90) dst[(size_t)lx * WIDTH + (lh - 1 - ly)] = p;
+            else                  dst[(size_t)(lw - 1 - lx) * WIDTH + ly] = p;
+        }
+    }
+}
+
+static int rotation_init(int degrees) {
+    if (degrees != 0 && degrees != 90 && degrees != 180 && degrees != 270) return -1;
+    g_rotation = degrees;
+    g_logical_w = (degrees == 90 || degrees == 270) ? HEIGHT : WIDTH;
+    g_logical_h = (degrees == 90 || degrees == 270) ? WIDTH  : HEIGHT;
+    return 0;
+}
+
+/* touch: panel coordinate -> logical coordinate (inverse rotation) */
+static inline void rotate_panel_to_logical(int *x, int *y) {
+    int px = *x, py = *y;
+    switch (g_rotation) {
+    case 90:  *x = py;                   *y = g_logical_h - 1 - px; break;
+    case 180: *x = g_logical_w - 1 - px; *y = g_logical_h - 1 - py; break;
+    case 270: *x = g_logical_w - 1 - py; *y = px;                   break;
+    default: break;
+    }
+}
+
+/* touch: panel coordinate -> canvas coordinate */
+static inline void panel_to_canvas(int *x, int *y) {
+    rotate_panel_to_logical(x, y);
+    scaler_panel_to_source(&g_scaler, x, y);
+}
+
+/* logical rows [ly0, ly1) of the canvas -> transfer-ready panel frame (scale/letterbox, rotate) */
+static void present_rows(uint16_t *dst, int ly0, int ly1) {
+    if (g_rotation == 0) {
+        uint16_t *d = dst + (size_t)ly0 * WIDTH;
+        if (g_scaler.active) scaler_rows(&g_scaler, g_canvas.px, ly0, ly1, d);
+        else if (dst != g_canvas.px) memcpy(d, g_canvas.px + (size_t)ly0 * WIDTH, (size_t)(ly1 - ly0) * WIDTH * 2);
+        return;
+    }
+    for (int ly = ly0; ly < ly1; ly += ROTATE_BAND) {
+        int n = ly1 - ly < ROTATE_BAND ? ly1 - ly : ROTATE_BAND;
+        const uint16_t *band;
+        if (g_scaler.active) {
+            scaler_rows(&g_scaler, g_canvas.px, ly, ly + n, rotate_band_buf);
+            band = rotate_band_buf;
+        } else {
+            band = g_canvas.px + (size_t)ly * g_logical_w;
+        }
+        rotate_band(band, ly, n, dst);
+    }
+}
+
+static void present_frame(uint16_t *dst) {
+    present_rows(dst, 0, g_logical_h);
+}
+
+/* time util */
+static inline uint64_t now_us(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+}
+static inline uint64_t now_ns(void) {
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* libusbmonitor instance */
+static usb_monitor_t *g_mon = NULL;
+
+/* touch */
+typedef struct {
+    usb_monitor_touch_t dec;   // axis ranges + pending values (library decoder)
     int last_x,last_y;
     int has_pos;
     #ifdef AUTO_RANDOM_MOVE
@@ -89,459 +485,1392 @@ typedef struct {
 } touch_state_t;
 static touch_state_t g_touch = {0};
 
-/* helper prototypes (defined below) */
-static int connect_device(void);
-static int send_frame_sync(libusb_device_handle *h);
-
-/* ---------- functions for matching event node to libusb device ---------- */
-
-/* read small file into buffer (trim newline) */
-static int read_file_to_buf(const char *path, char *buf, size_t sz) {
-    if (!path || !buf) return -1;
-    FILE *f = fopen(path, "r");
-    if (!f) return -1;
-    if (!fgets(buf, (int)sz, f)) { fclose(f); return -1; }
-    // trim newline
-    size_t L = strlen(buf);
-    while (L > 0 && (buf[L-1] == '\n' || buf[L-1] == '\r')) { buf[L-1] = '\0'; L--; }
-    fclose(f);
-    return 0;
+/* evdev event -> canvas position (the decoder yields panel pixels) */
+static void update_touch_from_event(const struct input_event *ev) {
+    int sx, sy;
+    if (!ev || !usb_monitor_touch_decode(&g_touch.dec, ev, &sx, &sy)) return;
+    panel_to_canvas(&sx, &sy);   // panel -> canvas 좌표 (rotation, scaling 역변환)
+    g_touch.last_x = sx; g_touch.last_y = sy; g_touch.has_pos = 1;
+    #ifdef AUTO_RANDOM_MOVE
+    g_touch.updated = 1;   // <<< ADDED
+    #endif
 }
 
+
+/* ---------- capture / replay of frame stream and touch input ---------- */
+
 /*
- * Try to find /dev/input/eventN which belongs to the same USB device as the libusb handle.
- * We compare idVendor/idProduct and, if available, iSerialNumber (string desc).
+ * Capture file layout (little endian):
+ *   capture_file_header_t
+ *   records: u8 type, varint dt_us (since previous record), type specific payload
+ *     CAPTURE_REC_EVDEV        varint ev.type, varint ev.code, zigzag varint ev.value
+ *     CAPTURE_REC_XFER_SUBMIT  varint length
+ *     CAPTURE_REC_XFER_DONE    zigzag varint status, varint actual_length
+ *     CAPTURE_REC_FRAME        u64 key, varint encoded_size, then runs of
+ *                              (varint skip_pixels, varint literal_pixels, literal_pixels*2 bytes)
+ *                              against the previous CAPTURE_REC_FRAME (first frame: against all zero)
+ *     CAPTURE_REC_FRAME_REF    u64 key: same payload as one of the last CAPTURE_REF_FRAMES
+ *                              CAPTURE_REC_FRAME records (cache hit / repeated frame)
+ *     CAPTURE_REC_END          varint dropped_records, varint dropped_frames
  *
- * out_event_path must have size at least PATH_MAX.
- * Returns 0 on success and writes "/dev/input/eventN" into out_event_path. -1 on failure.
+ * The hot path only appends fixed size records to a single-producer ring and fills a free frame
+ * slot; delta compression and file I/O run on the writer thread. A frame whose key is among the
+ * last CAPTURE_REF_FRAMES recorded ones is not stored again, only referenced.
+ * The slot is filled from cached memory, never read back from the transfer buffer (usbfs DMA
+ * memory, possibly uncached): the payload is presented into the slot and copied from there into
+ * the frame, or taken from the replayed frame (see capture_frame_slot()).
+ * Ring/slot이 가득 차면 기다리지 않고 해당 record를 버리고 drop 카운트만 올린다.
  */
-static int find_event_for_libusb_device(libusb_device_handle *h, char *out_event_path, size_t out_sz) {
-    if (!h || !out_event_path) return -1;
-
-    libusb_device *dev = libusb_get_device(h);
-    if (!dev) return -1;
-
-    struct libusb_device_descriptor desc;
-    if (libusb_get_device_descriptor(dev, &desc) < 0) return -1;
-
-    // optional serial string
-    char serial_str[256] = {0};
-    if (desc.iSerialNumber) {
-        if (libusb_get_string_descriptor_ascii(h, desc.iSerialNumber,
-                                              (unsigned char*)serial_str, sizeof(serial_str)) < 0) {
-            serial_str[0] = '\0';
-        }
-    }
-
-    // vendor/product from descriptor (hex)
-    unsigned short vid = desc.idVendor;
-    unsigned short pid = desc.idProduct;
-
-    // iterate /dev/input/eventN
-    for (int i = 0; i < TOUCH_EVENT_SCAN_MAX; ++i) {
-        char devnode[64]; snprintf(devnode, sizeof(devnode), "/dev/input/event%d", i);
-        // if node doesn't exist skip
-        if (access(devnode, R_OK) != 0) continue;
-
-        // resolve sysfs path for this event: /sys/class/input/eventN/device (resolve symlink)
-        char syslink[PATH_MAX];
-        snprintf(syslink, sizeof(syslink), "/sys/class/input/event%d/device", i);
-
-        char resolved[PATH_MAX];
-        if (!realpath(syslink, resolved)) continue;
-
-        // walk up directories until we find idVendor && idProduct files (or root)
-        char cur[PATH_MAX];
-        strncpy(cur, resolved, sizeof(cur));
-        cur[sizeof(cur)-1] = '\0';
-        bool matched = false;
-        while (1) {
-            // build candidate idVendor path
-            char vid_path[PATH_MAX], pid_path[PATH_MAX], serial_path[PATH_MAX];
-            snprintf(vid_path, sizeof(vid_path), "%s/idVendor", cur);
-            snprintf(pid_path, sizeof(pid_path), "%s/idProduct", cur);
-            snprintf(serial_path, sizeof(serial_path), "%s/serial", cur);
-
-            if (access(vid_path, R_OK) == 0 && access(pid_path, R_OK) == 0) {
-                char vbuf[64], pbuf[64];
-                if (read_file_to_buf(vid_path, vbuf, sizeof(vbuf)) < 0) break;
-                if (read_file_to_buf(pid_path, pbuf, sizeof(pbuf)) < 0) break;
-                unsigned int v = (unsigned int)strtoul(vbuf, NULL, 16);
-                unsigned int p = (unsigned int)strtoul(pbuf, NULL, 16);
-                if ((unsigned int)vid == v && (unsigned int)pid == p) {
-                    // if serial is available from libusb, try to match sysfs 'serial' if present
-                    if (serial_str[0] != '\0' && access(serial_path, R_OK) == 0) {
-                        char sfs[256] = {0};
-                        if (read_file_to_buf(serial_path, sfs, sizeof(sfs)) == 0) {
-                            if (strcmp(serial_str, sfs) == 0) {
-                                matched = true; // vendor/pid and serial match
-                            } else {
-                                matched = false;
-                            }
-                        } else {
-                            matched = false;
-                        }
-                    } else {
-                        // serial not available or not present; accept vendor/pid match
-                        matched = true;
-                    }
-                }
-                // either way, break from loop to check matched flag
-                break;
-            }
+#define CAPTURE_MAGIC          "LJSCAP02"
+#define CAPTURE_RING_RECORDS   4096   // power of two
+#define CAPTURE_FRAME_SLOTS    4
+#define CAPTURE_REF_FRAMES     16     // recorded frames a reference can name (replay keeps as many)
+#define CAPTURE_WRITER_IDLE_US 2000
+
+#define CAPTURE_REC_EVDEV       1
+#define CAPTURE_REC_XFER_SUBMIT 2
+#define CAPTURE_REC_XFER_DONE   3
+#define CAPTURE_REC_FRAME       4
+#define CAPTURE_REC_FRAME_REF   5
+#define CAPTURE_REC_END         0xFF
+
+typedef struct CAPTURE_FILE_HEADER {
+    char     magic[8];
+    uint16_t width;
+    uint16_t height;
+    uint8_t  pixel_format;      // SCREEN_PIXEL_FORMAT_RGB565
+    uint8_t  have_mt;           // touch caps, replay에서 실제 touch 장치 없이 좌표 변환을 재현하기 위함
+    uint8_t  have_st;
+    uint8_t  reserved;
+    int32_t  abs_min_x, abs_max_x;
+    int32_t  abs_min_y, abs_max_y;
+    uint32_t rand_seed;         // AUTO_RANDOM_MOVE 재현용
+    uint64_t start_realtime_us; // wall clock at capture start (field log와 대조용)
+} __attribute__((packed)) capture_file_header_t;
 
-            // go one level up
-            char *slash = strrchr(cur, '/');
-            if (!slash || slash == cur) break;
-            *slash = '\0';
-        } // end walk up
+typedef struct {
+    uint64_t t_us;
+    uint64_t key;       // frame, frame ref
+    uint8_t  type;
+    int32_t  a, b, c;   // evdev: type/code/value, submit: length, done: status/actual, frame: slot
+} capture_rec_t;
 
-        if (matched) {
-            // success: return devnode
-            strncpy(out_event_path, devnode, out_sz);
-            out_event_path[out_sz-1] = '\0';
-            return 0;
-        }
+typedef struct {
+    FILE *f;
+    pthread_t writer;
+    int active;
+    atomic_int stop;
+    uint64_t start_us;
+
+    capture_rec_t ring[CAPTURE_RING_RECORDS];
+    atomic_uint head;   // written by producer (main thread)
+    atomic_uint tail;   // written by writer thread
+
+    uint16_t *slots[CAPTURE_FRAME_SLOTS];
+    atomic_int slot_busy[CAPTURE_FRAME_SLOTS];
+
+    /* writer thread only */
+    uint16_t *prev;     // previous recorded frame (delta base)
+    uint8_t  *enc;      // encoded frame scratch
+    uint64_t last_written_us;
+
+    /* producer side: keys of the last CAPTURE_REF_FRAMES frame records, in record order */
+    uint64_t ref_keys[CAPTURE_REF_FRAMES];
+    int ref_count, ref_next;
+    int pending_slot;       // filled by the producer, recorded once the frame is submitted (-1: none)
+    uint64_t pending_key;
+
+    /* producer side stats */
+    uint64_t records, frames, frame_refs, dropped_records, dropped_frames;
+} capture_t;
+static capture_t g_capture;
+
+static inline size_t varint_put(uint8_t *out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) { out[n++] = (uint8_t)(v | 0x80); v >>= 7; }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+static inline size_t u64_put(uint8_t *out, uint64_t v) {
+    for (int i = 0; i < 8; i++) out[i] = (uint8_t)(v >> (8 * i));
+    return 8;
+}
+static int u64_get(FILE *f, uint64_t *out) {
+    uint8_t b[8];
+    if (fread(b, 1, 8, f) != 8) return -1;
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= (uint64_t)b[i] << (8 * i);
+    *out = v;
+    return 8;
+}
+static inline uint64_t zigzag_enc(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+static inline int64_t zigzag_dec(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+/* returns number of bytes consumed, -1 on EOF/overlong */
+static int varint_get(FILE *f, uint64_t *out) {
+    uint64_t v = 0;
+    for (int shift = 0, n = 1; shift < 64; shift += 7, n++) {
+        int c = fgetc(f);
+        if (c == EOF) return -1;
+        v |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) { *out = v; return n; }
     }
     return -1;
 }
 
-/* ---------- existing helpers (open/close/autodetect fallback etc.) ---------- */
-static int open_touch_device_by_libevdev(touch_device_info_t *out, const char *path) {
-    if (!out || !path) return -1;
-    int fd = open(path, O_RDONLY | O_NONBLOCK);
-    if (fd < 0) return -1;
-    struct libevdev *dev = NULL;
-    if (libevdev_new_from_fd(fd, &dev) < 0) { close(fd); return -1; }
-    out->fd = fd; out->dev = dev; return 0;
-}
-static void close_touch_device_by_libevdev(touch_device_info_t *t) {
-    if (!t) return;
-    if (t->dev) libevdev_free(t->dev);
-    if (t->fd >= 0) close(t->fd);
-    t->dev = NULL; t->fd = -1;
-}
-static int autodetect_touch_event_path(char *out_path, size_t out_sz) {
-    // kept as fallback: checks for any event node with ABS capabilities
-    for (int i = 0; i < TOUCH_EVENT_SCAN_MAX; i++) {
-        char p[64]; snprintf(p, sizeof(p), "/dev/input/event%d", i);
-        if (access(p, R_OK) != 0) continue;
-        int fd = open(p, O_RDONLY | O_NONBLOCK);
-        if (fd < 0) continue;
-        struct libevdev *d = NULL;
-        if (libevdev_new_from_fd(fd, &d) == 0) {
-            bool ok = libevdev_has_event_type(d, EV_ABS) &&
-                      ((libevdev_has_event_code(d, EV_ABS, ABS_MT_POSITION_X) &&
-                        libevdev_has_event_code(d, EV_ABS, ABS_MT_POSITION_Y)) ||
-                       (libevdev_has_event_code(d, EV_ABS, ABS_X) &&
-                        libevdev_has_event_code(d, EV_ABS, ABS_Y)));
-            if (ok) {
-                strncpy(out_path, p, out_sz); out_path[out_sz-1] = '\0';
-                libevdev_free(d); close(fd); return 0;
-            }
-            libevdev_free(d);
+/* delta against prev (updated in place); returns encoded size */
+static size_t capture_encode_frame(uint8_t *out, uint16_t *prev, const uint16_t *cur, size_t pixels) {
+    size_t n = 0, i = 0;
+    while (i < pixels) {
+        size_t skip_start = i;
+        // 변경 없는 구간은 8byte 단위로 건너뛴다
+        while (i + 4 <= pixels && memcmp(prev + i, cur + i, 8) == 0) i += 4;
+        while (i < pixels && prev[i] == cur[i]) i++;
+        size_t lit_start = i;
+        while (i < pixels && prev[i] != cur[i]) i++;
+        size_t lit = i - lit_start;
+        n += varint_put(out + n, lit_start - skip_start);
+        n += varint_put(out + n, lit);
+        if (lit) {
+            memcpy(out + n, cur + lit_start, lit * 2);
+            memcpy(prev + lit_start, cur + lit_start, lit * 2);
+            n += lit * 2;
         }
-        close(fd);
     }
-    return -1;
+    return n;
 }
 
-/* init touch caps from libevdev device */
-static void init_touch_caps_from_dev(struct libevdev *dev) {
-    memset(&g_touch,0,sizeof(g_touch));
-    g_touch.have_mt = libevdev_has_event_code(dev, EV_ABS, ABS_MT_POSITION_X) &&
-                      libevdev_has_event_code(dev, EV_ABS, ABS_MT_POSITION_Y);
-    g_touch.have_st = libevdev_has_event_code(dev, EV_ABS, ABS_X) &&
-                      libevdev_has_event_code(dev, EV_ABS, ABS_Y);
-    const struct input_absinfo *ax=NULL,*ay=NULL;
-    if (g_touch.have_mt) { ax = libevdev_get_abs_info(dev, ABS_MT_POSITION_X); ay = libevdev_get_abs_info(dev, ABS_MT_POSITION_Y); }
-    else if (g_touch.have_st) { ax = libevdev_get_abs_info(dev, ABS_X); ay = libevdev_get_abs_info(dev, ABS_Y); }
-    if (ax && ay) {
-        g_touch.abs_min_x = ax->minimum; g_touch.abs_max_x = ax->maximum;
-        g_touch.abs_min_y = ay->minimum; g_touch.abs_max_y = ay->maximum;
-    } else {
-        g_touch.abs_min_x = 0; g_touch.abs_max_x = 65535;
-        g_touch.abs_min_y = 0; g_touch.abs_max_y = 65535;
+static int capture_decode_frame(FILE *f, uint16_t *frame, size_t pixels, uint64_t encoded_size) {
+    size_t i = 0;
+    uint64_t left = encoded_size;
+    while (left > 0) {
+        uint64_t skip = 0, lit = 0;
+        int n1 = varint_get(f, &skip), n2 = varint_get(f, &lit);
+        // varint 값은 신뢰할 수 없으므로 더하기 전에 각각 범위를 확인 (overflow 방지)
+        if (n1 < 0 || n2 < 0 || lit > left / 2 || (uint64_t)(n1 + n2) > left - lit * 2) return -1;
+        if (skip > pixels - i || lit > pixels - i - skip) return -1;
+        i += skip;
+        if (lit && fread(frame + i, 2, lit, f) != lit) return -1;
+        i += lit;
+        left -= (uint64_t)(n1 + n2) + lit * 2;
     }
-    g_touch.has_pos = 0;
+    return 0;
 }
 
-/* update_touch_from_event same as before */
-static void update_touch_from_event(const struct input_event *ev) {
-    if (!ev) return;
-    static int cur_ax=-1, cur_ay=-1;
-    if (g_touch.have_mt) {
-        if (ev->type == EV_ABS) {
-            if (ev->code == ABS_MT_POSITION_X) cur_ax = ev->value;
-            else if (ev->code == ABS_MT_POSITION_Y) cur_ay = ev->value;
-        } else if (ev->type == EV_SYN && ev->code == SYN_REPORT) {
-            if (cur_ax>=0 && cur_ay>=0) {
-                int sx = (int)((long long)(cur_ax - g_touch.abs_min_x) * (WIDTH-1) / (g_touch.abs_max_x - g_touch.abs_min_x));
-                int sy = (int)((long long)(cur_ay - g_touch.abs_min_y) * (HEIGHT-1) / (g_touch.abs_max_y - g_touch.abs_min_y));
-                g_touch.last_x = sx; g_touch.last_y = sy; g_touch.has_pos = 1;
-                #ifdef AUTO_RANDOM_MOVE
-                g_touch.updated = 1;   // <<< ADDED
-                #endif
-                cur_ax = cur_ay = -1;
-            }
+static void capture_write_record(const capture_rec_t *rec) {
+    capture_t *c = &g_capture;
+    uint8_t hdr[32];
+    size_t n = 0;
+    hdr[n++] = rec->type;
+    uint64_t t = rec->t_us - c->start_us;
+    n += varint_put(hdr + n, t - c->last_written_us);
+    c->last_written_us = t;
+    switch (rec->type) {
+    case CAPTURE_REC_EVDEV:
+        n += varint_put(hdr + n, (uint32_t)rec->a);
+        n += varint_put(hdr + n, (uint32_t)rec->b);
+        n += varint_put(hdr + n, zigzag_enc(rec->c));
+        break;
+    case CAPTURE_REC_XFER_SUBMIT:
+        n += varint_put(hdr + n, (uint32_t)rec->a);
+        break;
+    case CAPTURE_REC_XFER_DONE:
+        n += varint_put(hdr + n, zigzag_enc(rec->a));
+        n += varint_put(hdr + n, (uint32_t)rec->b);
+        break;
+    case CAPTURE_REC_FRAME_REF:
+        n += u64_put(hdr + n, rec->key);
+        break;
+    case CAPTURE_REC_FRAME: {
+        size_t enc = capture_encode_frame(c->enc, c->prev, c->slots[rec->a], WIDTH * HEIGHT);
+        atomic_store_explicit(&c->slot_busy[rec->a], 0, memory_order_release);
+        n += u64_put(hdr + n, rec->key);
+        n += varint_put(hdr + n, enc);
+        fwrite(hdr, 1, n, c->f);
+        fwrite(c->enc, 1, enc, c->f);
+        return;
+    }
+    }
+    fwrite(hdr, 1, n, c->f);
+}
+
+static void *capture_writer_main(void *arg) {
+    capture_t *c = (capture_t*)arg;
+    for (;;) {
+        unsigned tail = atomic_load_explicit(&c->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&c->head, memory_order_acquire);
+        if (tail == head) {
+            if (atomic_load(&c->stop)) break;
+            fflush(c->f);
+            usleep(CAPTURE_WRITER_IDLE_US);
+            continue;
         }
-    } else if (g_touch.have_st) {
-        if (ev->type == EV_ABS) {
-            if (ev->code == ABS_X) cur_ax = ev->value;
-            else if (ev->code == ABS_Y) cur_ay = ev->value;
-        } else if (ev->type == EV_SYN && ev->code == SYN_REPORT) {
-            if (cur_ax>=0 && cur_ay>=0) {
-                int sx = (int)((long long)(cur_ax - g_touch.abs_min_x) * (WIDTH-1) / (g_touch.abs_max_x - g_touch.abs_min_x));
-                int sy = (int)((long long)(cur_ay - g_touch.abs_min_y) * (HEIGHT-1) / (g_touch.abs_max_y - g_touch.abs_min_y));
-                g_touch.last_x = sx; g_touch.last_y = sy; g_touch.has_pos = 1;
-                #ifdef AUTO_RANDOM_MOVE
-                g_touch.updated = 1;   // <<< ADDED
-                #endif
-                cur_ax = cur_ay = -1;
-            }
+        while (tail != head) {
+            capture_write_record(&c->ring[tail & (CAPTURE_RING_RECORDS - 1)]);
+            tail++;
         }
+        atomic_store_explicit(&c->tail, tail, memory_order_release);
     }
+    return NULL;
 }
 
+/* hot path: non-blocking append, drops when the writer is behind */
+static inline int capture_push(uint8_t type, int32_t a, int32_t b, int32_t cc, uint64_t key) {
+    capture_t *c = &g_capture;
+    unsigned head = atomic_load_explicit(&c->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&c->tail, memory_order_acquire);
+    if (head - tail >= CAPTURE_RING_RECORDS) { c->dropped_records++; return -1; }
+    capture_rec_t *r = &c->ring[head & (CAPTURE_RING_RECORDS - 1)];
+    r->t_us = now_us(); r->key = key; r->type = type; r->a = a; r->b = b; r->c = cc;
+    atomic_store_explicit(&c->head, head + 1, memory_order_release);
+    c->records++;
+    return 0;
+}
 
-/* ====== send_frame_sync (chunked) as before ====== */
-static int send_frame_sync(libusb_device_handle *h) {
-    if (!h) return LIBUSB_ERROR_NO_DEVICE;
-    const int total_bytes = WIDTH * HEIGHT * 2;
-    uint8_t *data = (uint8_t*)framebuffer;
-    int offset = 0;
-    int timeout_ms = 1000;
-    while (offset < total_bytes) {
-        int chunk = total_bytes - offset;
-        if (chunk > PACKET_SIZE) chunk = PACKET_SIZE;
-        int transferred = 0;
-        int r = libusb_bulk_transfer(h, EP_OUT, data + offset, chunk, &transferred, timeout_ms);
-        if (r == LIBUSB_ERROR_NO_DEVICE) return LIBUSB_ERROR_NO_DEVICE;
-        if (r != 0) {
-            fprintf(stderr, "libusb_bulk_transfer error at offset %d: %s (%d)\n", offset, libusb_error_name(r), r);
-            return r;
-        }
-        if (transferred <= 0) {
-            fprintf(stderr, "libusb_bulk_transfer transferred 0 at offset %d\n", offset);
-            return -1;
+static inline void capture_evdev(const struct input_event *ev) {
+    if (g_capture.active) capture_push(CAPTURE_REC_EVDEV, ev->type, ev->code, ev->value, 0);
+}
+static inline void capture_xfer_submit(int length) {
+    if (g_capture.active) capture_push(CAPTURE_REC_XFER_SUBMIT, length, 0, 0, 0);
+}
+static inline void capture_xfer_done(int status, int actual_length) {
+    if (g_capture.active) capture_push(CAPTURE_REC_XFER_DONE, status, actual_length, 0, 0);
+}
+static inline int capture_key_recorded(const capture_t *c, uint64_t key) {
+    for (int i = 0; i < c->ref_count; i++) if (c->ref_keys[i] == key) return 1;
+    return 0;
+}
+
+/* give back a slot that was filled for a frame that is not going to be sent */
+static void capture_frame_cancel(void) {
+    capture_t *c = &g_capture;
+    if (c->pending_slot < 0) return;
+    atomic_store_explicit(&c->slot_busy[c->pending_slot], 0, memory_order_relaxed);
+    c->pending_slot = -1;
+}
+
+/*
+ * Slot for the payload of the frame about to be sent with content key, to be filled by the
+ * caller from cached memory (present_frame() or the replayed frame). NULL when not recording,
+ * when the key is among the last recorded frames (capture_frame() writes a 9 byte reference
+ * instead) or when every slot is still queued for the writer.
+ */
+static uint16_t *capture_frame_slot(uint64_t key) {
+    capture_t *c = &g_capture;
+    if (!c->active) return NULL;
+    capture_frame_cancel();
+    if (capture_key_recorded(c, key)) return NULL;
+    for (int i = 0; i < CAPTURE_FRAME_SLOTS; i++) {
+        if (atomic_load_explicit(&c->slot_busy[i], memory_order_acquire)) continue;
+        atomic_store_explicit(&c->slot_busy[i], 1, memory_order_relaxed);
+        c->pending_slot = i;
+        c->pending_key = key;
+        return c->slots[i];
+    }
+    return NULL;
+}
+
+/* frame with content key has been submitted: record the filled slot, or a reference to it */
+static void capture_frame(uint64_t key) {
+    capture_t *c = &g_capture;
+    if (!c->active) return;
+    if (c->pending_slot >= 0 && c->pending_key == key) {
+        int i = c->pending_slot;
+        c->pending_slot = -1;
+        if (capture_push(CAPTURE_REC_FRAME, i, 0, 0, key) != 0) {
+            atomic_store(&c->slot_busy[i], 0);
+            c->dropped_frames++;
+            return;
         }
-        offset += transferred;
+        c->frames++;
+        // replay fills its frame store in the same order
+        c->ref_keys[c->ref_next] = key;
+        c->ref_next = (c->ref_next + 1) % CAPTURE_REF_FRAMES;
+        if (c->ref_count < CAPTURE_REF_FRAMES) c->ref_count++;
+        return;
+    }
+    capture_frame_cancel();
+    if (capture_key_recorded(c, key) && capture_push(CAPTURE_REC_FRAME_REF, 0, 0, 0, key) == 0) c->frame_refs++;
+    else c->dropped_frames++;
+}
+
+static int capture_start(const char *path, uint32_t rand_seed) {
+    capture_t *c = &g_capture;
+    c->f = fopen(path, "wb");
+    if (!c->f) { perror("capture fopen"); return -1; }
+    setvbuf(c->f, NULL, _IOFBF, 1 << 20);
+    int oom = 0;
+    for (int i = 0; i < CAPTURE_FRAME_SLOTS; i++) {
+        c->slots[i] = (uint16_t*)malloc(FRAME_BYTES);
+        if (!c->slots[i]) oom = 1;
+        else memset(c->slots[i], 0, FRAME_BYTES);   // prefault: 첫 frame 복사에서 page fault 방지
+        atomic_init(&c->slot_busy[i], 0);
+    }
+    c->prev = (uint16_t*)calloc(1, FRAME_BYTES);
+    c->enc  = (uint8_t*)malloc((size_t)FRAME_BYTES * 2 + 64); // worst case: 1px runs
+    if (oom || !c->prev || !c->enc) {
+        fprintf(stderr, "capture: out of memory\n");
+        for (int i = 0; i < CAPTURE_FRAME_SLOTS; i++) { free(c->slots[i]); c->slots[i] = NULL; }
+        free(c->prev); c->prev = NULL; free(c->enc); c->enc = NULL;
+        fclose(c->f); c->f = NULL; return -1;
+    }
+
+    capture_file_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CAPTURE_MAGIC, sizeof(h.magic));
+    h.width = WIDTH; h.height = HEIGHT; h.pixel_format = SCREEN_PIXEL_FORMAT_RGB565;
+    h.have_mt = (uint8_t)g_touch.dec.have_mt; h.have_st = (uint8_t)g_touch.dec.have_st;
+    h.abs_min_x = g_touch.dec.abs_min_x; h.abs_max_x = g_touch.dec.abs_max_x;
+    h.abs_min_y = g_touch.dec.abs_min_y; h.abs_max_y = g_touch.dec.abs_max_y;
+    h.rand_seed = rand_seed;
+    struct timespec ts; clock_gettime(CLOCK_REALTIME, &ts);
+    h.start_realtime_us = (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
+    fwrite(&h, sizeof(h), 1, c->f);
+
+    c->start_us = now_us();
+    c->last_written_us = 0;
+    c->ref_count = c->ref_next = 0;
+    c->pending_slot = -1;
+    atomic_init(&c->head, 0); atomic_init(&c->tail, 0); atomic_init(&c->stop, 0);
+    if (pthread_create(&c->writer, NULL, capture_writer_main, c) != 0) {
+        fprintf(stderr, "capture: failed to start writer thread\n");
+        fclose(c->f); c->f = NULL; return -1;
     }
+    c->active = 1;
+    printf("Recording capture to %s\n", path);
     return 0;
 }
 
+static void capture_stop(void) {
+    capture_t *c = &g_capture;
+    if (!c->active) return;
+    c->active = 0;
+    atomic_store(&c->stop, 1);
+    pthread_join(c->writer, NULL);
+    uint8_t end[24]; size_t n = 0;
+    end[n++] = CAPTURE_REC_END;
+    n += varint_put(end + n, 0);
+    n += varint_put(end + n, c->dropped_records);
+    n += varint_put(end + n, c->dropped_frames);
+    fwrite(end, 1, n, c->f);
+    fclose(c->f); c->f = NULL;
+    printf("capture: records=%llu frames=%llu frame_refs=%llu dropped_records=%llu dropped_frames=%llu\n",
+           (unsigned long long)c->records, (unsigned long long)c->frames, (unsigned long long)c->frame_refs,
+           (unsigned long long)c->dropped_records, (unsigned long long)c->dropped_frames);
+    for (int i = 0; i < CAPTURE_FRAME_SLOTS; i++) { free(c->slots[i]); c->slots[i] = NULL; }
+    free(c->prev); c->prev = NULL;
+    free(c->enc); c->enc = NULL;
+}
 
-/* Replace the old check_usb_device_disconnected() with this enhanced version.
- *
- * Logic:
- * - If handle is NULL -> consider disconnected.
- * - Get libusb_device* from handle; read its bus number and port numbers (path).
- * - Enumerate current libusb device list and try to find a device with same bus and same port-path.
- * - If not found -> device physically disconnected.
- * - Also treat libusb_get_device_descriptor() failures and libusb_handle_events_timeout_completed()
- *   returning LIBUSB_ERROR_NO_DEVICE as disconnect.
- *
- * This is more robust in scenarios where the handle exists but the physical device has been unplugged.
+/*
+ * Replay: records are released on the original timeline (relative to replay start).
+ *   REPLAY_INPUT  : evdev events are fed to update_touch_from_event(); the live render/transfer
+ *                   pipeline runs as usual, so changes to it can be benchmarked on a real trace.
+ *   REPLAY_FRAMES : recorded frames are re-submitted as they were sent (transfer-side repro).
+ * Transfer latency (submit -> callback) of the original run is accumulated from the file and
+ * printed next to the latency measured during replay.
  */
-static bool check_usb_device_disconnected(void) {
-    if (!ctx) return true;            // sanity
-    if (!handle) {
-        // No handle -> definitely disconnected
-        return true;
-    }
-
-    libusb_device *dev = libusb_get_device(handle);
-    if (!dev) {
-        // cannot obtain device from handle -> treat as disconnected
-        return true;
-    }
-
-    // 1) Quick descriptor check: if libusb reports NO_DEVICE here, it's gone.
-    struct libusb_device_descriptor desc;
-    int r = libusb_get_device_descriptor(dev, &desc);
-    if (r == LIBUSB_ERROR_NO_DEVICE) {
-        // physical device gone
-        return true;
-    }
-    // If other error, continue to deeper checks (we don't fail on other small errors)
-
-    // 2) Get bus number and port numbers (port path)
-    uint8_t ports_saved[16];
-    int depth_saved = libusb_get_port_numbers(dev, ports_saved, sizeof(ports_saved));
-    uint8_t bus_saved = libusb_get_bus_number(dev);
-
-    // If we couldn't obtain port numbers (depth <= 0), fall back to descriptor-based check:
-    // iterate device list and check for any device with same vid/pid on same bus.
-    libusb_device **devs = NULL;
-    ssize_t cnt = libusb_get_device_list(ctx, &devs);
-    if (cnt < 0) {
-        // can't list devices -> conservative: ask libusb event loop if it says device gone
-        struct timeval tv = {0, 0};
-        int hr = libusb_handle_events_timeout_completed(ctx, &tv, NULL);
-        return (hr == LIBUSB_ERROR_NO_DEVICE);
-    }
-
-    bool found = false;
-    for (ssize_t i = 0; i < cnt; ++i) {
-        libusb_device *d = devs[i];
-
-        // quick bus check
-        if (libusb_get_bus_number(d) != bus_saved) continue;
-
-        if (depth_saved > 0) {
-            // compare port-number path
-            uint8_t ports_cur[16];
-            int depth_cur = libusb_get_port_numbers(d, ports_cur, sizeof(ports_cur));
-            if (depth_cur == depth_saved) {
-                bool match = true;
-                for (int j = 0; j < depth_saved; ++j) {
-                    if (ports_saved[j] != ports_cur[j]) { match = false; break; }
-                }
-                if (match) { found = true; break; }
+#define REPLAY_NONE   0
+#define REPLAY_INPUT  1
+#define REPLAY_FRAMES 2
+
+typedef struct {
+    uint64_t count, sum_us, max_us;
+} latency_stat_t;
+
+static inline void latency_add(latency_stat_t *s, uint64_t us) {
+    s->count++; s->sum_us += us;
+    if (us > s->max_us) s->max_us = us;
+}
+static void latency_print(const char *name, const latency_stat_t *s) {
+    printf("%s: transfers=%llu avg=%.1f us max=%llu us\n", name, (unsigned long long)s->count,
+           s->count ? (double)s->sum_us / (double)s->count : 0.0, (unsigned long long)s->max_us);
+}
+
+typedef struct {
+    FILE *f;
+    int mode;
+    int eof;
+    uint64_t start_us;       // replay clock origin
+    uint64_t rec_t_us;       // timestamp of the pending record (capture time base)
+    int pending;             // a record header has been read but not applied yet
+    uint8_t pending_type;
+    uint16_t *frame;         // last CAPTURE_REC_FRAME (delta base)
+    uint16_t *store[CAPTURE_REF_FRAMES];   // REPLAY_FRAMES: last recorded frames, for references
+    uint64_t store_key[CAPTURE_REF_FRAMES];
+    int store_count, store_next;
+    const uint16_t *show;    // frame to submit next (REPLAY_FRAMES)
+    uint64_t show_key;
+    int frame_ready;         // new frame decoded since last taken (REPLAY_FRAMES)
+    uint64_t submit_t_us;
+    latency_stat_t recorded;
+    uint64_t events, frames;
+} replay_t;
+static replay_t g_replay;
+static latency_stat_t g_xfer_latency;   // measured on this run
+
+static int replay_open(const char *path, int mode, uint32_t *rand_seed) {
+    replay_t *r = &g_replay;
+    r->f = fopen(path, "rb");
+    if (!r->f) { perror("replay fopen"); return -1; }
+    capture_file_header_t h;
+    if (fread(&h, sizeof(h), 1, r->f) != 1 || memcmp(h.magic, CAPTURE_MAGIC, sizeof(h.magic)) != 0) {
+        fprintf(stderr, "replay: %s is not a capture file\n", path);
+        fclose(r->f); r->f = NULL; return -1;
+    }
+    if (h.width != WIDTH || h.height != HEIGHT || h.pixel_format != SCREEN_PIXEL_FORMAT_RGB565) {
+        fprintf(stderr, "replay: capture geometry %ux%u fmt %u does not match %dx%d\n",
+                h.width, h.height, h.pixel_format, WIDTH, HEIGHT);
+        fclose(r->f); r->f = NULL; return -1;
+    }
+    r->frame = (uint16_t*)calloc(1, FRAME_BYTES);
+    int oom = !r->frame;
+    for (int i = 0; mode == REPLAY_FRAMES && i < CAPTURE_REF_FRAMES; i++) {
+        r->store[i] = (uint16_t*)malloc(FRAME_BYTES);
+        if (!r->store[i]) oom = 1;
+    }
+    if (oom) {
+        fprintf(stderr, "replay: out of memory\n");
+        free(r->frame); r->frame = NULL;
+        for (int i = 0; i < CAPTURE_REF_FRAMES; i++) { free(r->store[i]); r->store[i] = NULL; }
+        fclose(r->f); r->f = NULL; return -1;
+    }
+
+    memset(&g_touch, 0, sizeof(g_touch));
+    g_touch.dec.struct_size = sizeof(g_touch.dec);
+    g_touch.dec.have_mt = h.have_mt; g_touch.dec.have_st = h.have_st;
+    g_touch.dec.abs_min_x = h.abs_min_x; g_touch.dec.abs_max_x = h.abs_max_x;
+    g_touch.dec.abs_min_y = h.abs_min_y; g_touch.dec.abs_max_y = h.abs_max_y;
+    g_touch.dec.panel_w = WIDTH; g_touch.dec.panel_h = HEIGHT;
+    g_touch.dec.pending_x = g_touch.dec.pending_y = -1;
+    *rand_seed = h.rand_seed;
+    r->mode = mode;
+    r->start_us = 0;
+    printf("Replaying %s (%s)\n", path, mode == REPLAY_FRAMES ? "frames" : "input");
+    return 0;
+}
+
+/* apply every record due at now; returns -1 at end of capture */
+static int replay_pump(uint64_t now) {
+    replay_t *r = &g_replay;
+    if (!r->f || r->eof) return -1;
+    if (!r->start_us) r->start_us = now;
+    for (;;) {
+        if (!r->pending) {
+            int type = fgetc(r->f);
+            uint64_t dt;
+            if (type == EOF || type == CAPTURE_REC_END || varint_get(r->f, &dt) < 0) { r->eof = 1; return -1; }
+            r->pending_type = (uint8_t)type;
+            r->rec_t_us += dt;
+            r->pending = 1;
+        }
+        if (r->rec_t_us > now - r->start_us) return 0;
+        r->pending = 0;
+
+        uint64_t a, b, c;
+        switch (r->pending_type) {
+        case CAPTURE_REC_EVDEV: {
+            if (varint_get(r->f, &a) < 0 || varint_get(r->f, &b) < 0 || varint_get(r->f, &c) < 0) { r->eof = 1; return -1; }
+            struct input_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.type = (uint16_t)a; ev.code = (uint16_t)b; ev.value = (int32_t)zigzag_dec(c);
+            if (r->mode == REPLAY_INPUT) update_touch_from_event(&ev);
+            r->events++;
+            break;
+        }
+        case CAPTURE_REC_XFER_SUBMIT:
+            if (varint_get(r->f, &a) < 0) { r->eof = 1; return -1; }
+            r->submit_t_us = r->rec_t_us;
+            break;
+        case CAPTURE_REC_XFER_DONE:
+            if (varint_get(r->f, &a) < 0 || varint_get(r->f, &b) < 0) { r->eof = 1; return -1; }
+            latency_add(&r->recorded, r->rec_t_us - r->submit_t_us);
+            break;
+        case CAPTURE_REC_FRAME:
+            if (u64_get(r->f, &c) < 0 || varint_get(r->f, &a) < 0 ||
+                capture_decode_frame(r->f, r->frame, WIDTH * HEIGHT, a) < 0) {
+                fprintf(stderr, "replay: corrupt frame record\n");
+                r->eof = 1; return -1;
             }
-        } else {
-            // fallback: match by idVendor/idProduct and bus + device address
-            struct libusb_device_descriptor ddesc;
-            if (libusb_get_device_descriptor(d, &ddesc) < 0) continue;
-            if (ddesc.idVendor == VENDOR_ID && ddesc.idProduct == PRODUCT_ID) {
-                // bus matches already; consider this a match (best-effort)
-                found = true;
-                break;
+            if (r->mode == REPLAY_FRAMES) {
+                // same order as capture_frame()'s ref_keys
+                uint16_t *slot = r->store[r->store_next];
+                memcpy(slot, r->frame, FRAME_BYTES);
+                r->store_key[r->store_next] = c;
+                r->store_next = (r->store_next + 1) % CAPTURE_REF_FRAMES;
+                if (r->store_count < CAPTURE_REF_FRAMES) r->store_count++;
+                r->show = slot; r->show_key = c;
+                r->frame_ready = 1;
+            }
+            r->frames++;
+            break;
+        case CAPTURE_REC_FRAME_REF: {
+            if (u64_get(r->f, &c) < 0) { r->eof = 1; return -1; }
+            if (r->mode == REPLAY_FRAMES) {
+                int i = 0;
+                while (i < r->store_count && r->store_key[i] != c) i++;
+                if (i == r->store_count) {
+                    fprintf(stderr, "replay: frame reference %016llx not found\n", (unsigned long long)c);
+                    r->eof = 1; return -1;
+                }
+                r->show = r->store[i]; r->show_key = c;
+                r->frame_ready = 1;
             }
+            r->frames++;
+            break;
+        }
+        default:
+            fprintf(stderr, "replay: unknown record type %u\n", r->pending_type);
+            r->eof = 1; return -1;
         }
     }
+}
+
+static void replay_close(void) {
+    replay_t *r = &g_replay;
+    if (!r->f) return;
+    printf("replay: events=%llu frames=%llu\n", (unsigned long long)r->events, (unsigned long long)r->frames);
+    latency_print("replay recorded", &r->recorded);
+    latency_print("replay measured", &g_xfer_latency);
+    fclose(r->f); r->f = NULL;
+    free(r->frame); r->frame = NULL;
+    for (int i = 0; i < CAPTURE_REF_FRAMES; i++) { free(r->store[i]); r->store[i] = NULL; }
+}
 
-    libusb_free_device_list(devs, 1);
+/* ---------- frame hashing ---------- */
 
-    if (!found) {
-        // device not present in system device list -> disconnected
-        return true;
+/*
+ * 64-bit hash used as the content address of a frame: XXH3 (vendored xxhash.h). Every stripe is
+ * mixed with a secret that depends on its position, so moved or swapped pixels, stripes and
+ * rows change the value; a plain sum of stripes would not see them.
+ */
+static inline uint64_t frame_hash64(const void *data, size_t len, uint64_t seed) {
+    return XXH3_64bits_withSeed(data, len, seed);
+}
+
+/* ---------- canvas content key ---------- */
+
+/*
+ * Frame keys are content hashes: frame_hash64 of every canvas row, then frame_hash64 of that
+ * row-hash table. A producer calls canvas_key_invalidate() for the rows it has written (any
+ * pixels, however they were rendered) and canvas_key() rehashes only those rows, so the cost
+ * follows the damage while equal canvases always get equal keys. The transfer-ready frame is a
+ * pure function of the canvas (scaling and rotation are fixed for the run), so the canvas key
+ * also addresses the payload.
+ * Rows set with canvas_key_exclude_rows() (fast changing content such as counters) are left out
+ * of the key; the caller refreshes them in the payload after the lookup. The content id covers
+ * every row and identifies the payload that is actually sent.
+ */
+static struct {
+    uint64_t *row;          // frame_hash64 per canvas row
+    int w, h;
+    int dirty_y0, dirty_y1; // rows to rehash, [y0, y1)
+    int skip_y0, skip_y1;   // rows left out of the key, [y0, y1)
+} g_ckey;
+
+static int canvas_key_init(void) {
+    g_ckey.row = (uint64_t*)calloc((size_t)g_canvas.h, sizeof(uint64_t));
+    if (!g_ckey.row) return -1;
+    g_ckey.w = g_canvas.w; g_ckey.h = g_canvas.h;
+    g_ckey.dirty_y0 = 0; g_ckey.dirty_y1 = g_canvas.h;
+    return 0;
+}
+
+static void canvas_key_free(void) {
+    free(g_ckey.row);
+    memset(&g_ckey, 0, sizeof(g_ckey));
+}
+
+/* canvas rows [y0, y1) have been written */
+static inline void canvas_key_invalidate(int y0, int y1) {
+    if (y0 < 0) y0 = 0;
+    if (y1 > g_ckey.h) y1 = g_ckey.h;
+    if (y0 >= y1) return;
+    if (g_ckey.dirty_y0 >= g_ckey.dirty_y1) { g_ckey.dirty_y0 = y0; g_ckey.dirty_y1 = y1; return; }
+    if (y0 < g_ckey.dirty_y0) g_ckey.dirty_y0 = y0;
+    if (y1 > g_ckey.dirty_y1) g_ckey.dirty_y1 = y1;
+}
+
+static void canvas_key_exclude_rows(int y0, int y1) {
+    if (y0 < 0) y0 = 0;
+    if (y1 > g_ckey.h) y1 = g_ckey.h;
+    g_ckey.skip_y0 = y0 < y1 ? y0 : 0;
+    g_ckey.skip_y1 = y0 < y1 ? y1 : 0;
+}
+
+/* cache key; *content (optional) also covers the excluded rows */
+static uint64_t canvas_key(uint64_t *content) {
+    const size_t row_bytes = (size_t)g_ckey.w * sizeof(uint16_t);
+    for (int y = g_ckey.dirty_y0; y < g_ckey.dirty_y1; y++)
+        g_ckey.row[y] = frame_hash64(g_canvas.px + (size_t)y * g_ckey.w, row_bytes, 0);
+    g_ckey.dirty_y0 = g_ckey.dirty_y1 = 0;
+    uint64_t all = frame_hash64(g_ckey.row, (size_t)g_ckey.h * sizeof(uint64_t), 0);
+    if (content) *content = all;
+    if (g_ckey.skip_y0 >= g_ckey.skip_y1) return all;
+    // rows above the excluded band seed the hash of the rows below it
+    uint64_t above = frame_hash64(g_ckey.row, (size_t)g_ckey.skip_y0 * sizeof(uint64_t), 0);
+    return frame_hash64(g_ckey.row + g_ckey.skip_y1, (size_t)(g_ckey.h - g_ckey.skip_y1) * sizeof(uint64_t), above);
+}
+
+/* ---------- content-addressed cache of transfer-ready frames ---------- */
+
+/*
+ * Bounded LRU cache: frame key (content hash, see canvas_key()) -> libusbmonitor frame
+ * holding the payload exactly as it goes out on EP_OUT. A hit skips raster/conversion and the
+ * frame is submitted again as is. Frames are borrowed from the library pool (usbfs zero-copy
+ * DMA memory when the kernel supports it, otherwise mlock()ed heap) and submitted with
+ * USB_MONITOR_SUBMIT_KEEP, so a cached payload is never copied.
+ * usbfs DMA memory and in-flight transfers share the usbfs_memory_mb budget, so the cache is
+ * capped below it (frame_cache_set_budget()) and scratch frames can still be submitted.
+ * 재연결 전에 frame_cache_release()로 돌려주면 새 handle의 dev_mem으로 다시 할당된다.
+ */
+typedef struct {
+    uint64_t key;
+    usb_monitor_frame_t *frame;
+    uint64_t last_use;   // LRU tick
+    int      valid;
+} frame_cache_entry_t;
+
+typedef struct {
+    frame_cache_entry_t entries[FRAME_CACHE_MAX_ENTRIES];
+    size_t   bytes_in_use;
+    size_t   max_bytes;
+    uint64_t tick;
+    uint64_t hits, misses, evictions, dup_skips, bypass;
+} frame_cache_t;
+static frame_cache_t g_fcache;
+
+/* returns the cached frame for key, or NULL on miss */
+static frame_cache_entry_t *frame_cache_lookup(uint64_t key) {
+    for (int i = 0; i < FRAME_CACHE_MAX_ENTRIES; i++) {
+        frame_cache_entry_t *e = &g_fcache.entries[i];
+        if (e->valid && e->key == key) {
+            e->last_use = ++g_fcache.tick;
+            g_fcache.hits++;
+            return e;
+        }
     }
+    g_fcache.misses++;
+    return NULL;
+}
 
-    // 3) Final guard: still run event pump to check USB stack errors
-    struct timeval tv = {0, 0};
-    int hr = libusb_handle_events_timeout_completed(ctx, &tv, NULL);
-    if (hr == LIBUSB_ERROR_NO_DEVICE) {
-        return true;
+/*
+ * Take a slot for key (a newly borrowed frame while under the byte budget, otherwise the least
+ * recently used slot whose frame is not in flight). The caller fills the frame in place.
+ * Returns NULL if every slot is busy; caller then sends from a scratch frame.
+ */
+static frame_cache_entry_t *frame_cache_reserve(uint64_t key) {
+    frame_cache_entry_t *victim = NULL, *empty = NULL;
+    for (int i = 0; i < FRAME_CACHE_MAX_ENTRIES; i++) {
+        frame_cache_entry_t *e = &g_fcache.entries[i];
+        if (!e->frame) { if (!empty) empty = e; continue; }
+        if (usb_monitor_frame_busy(g_mon, e->frame)) continue;
+        if (!victim || e->last_use < victim->last_use) victim = e;
+    }
+    frame_cache_entry_t *e = NULL;
+    size_t size = usb_monitor_frame_bytes(g_mon);
+    if (empty && g_fcache.bytes_in_use + size <= g_fcache.max_bytes) {
+        empty->frame = usb_monitor_frame_borrow(g_mon);
+        if (empty->frame) { g_fcache.bytes_in_use += size; e = empty; }
+    }
+    if (!e && victim) {
+        if (victim->valid) g_fcache.evictions++;
+        e = victim;
     }
+    if (!e) { g_fcache.bypass++; return NULL; }
+    e->key = key;
+    e->valid = 1;
+    e->last_use = ++g_fcache.tick;
+    return e;
+}
 
-    // device still present
-    return false;
+/*
+ * Cache byte budget: requested bytes, limited so that the cache plus the scratch frames fit in
+ * usbfs_memory_mb (0 there means no usbfs limit).
+ */
+static void frame_cache_set_budget(size_t requested, size_t frame_bytes) {
+    size_t budget = requested;
+    char buf[32];
+    FILE *f = fopen(USBFS_MEMORY_MB_PATH, "r");
+    long usbfs_mb = -1;
+    if (f) {
+        if (fgets(buf, sizeof(buf), f)) usbfs_mb = strtol(buf, NULL, 10);
+        fclose(f);
+    }
+    if (usbfs_mb > 0) {
+        size_t usbfs = (size_t)usbfs_mb * 1024u * 1024u, reserve = FRAME_POOL_SCRATCH * frame_bytes;
+        size_t limit = usbfs > reserve ? usbfs - reserve : 0;
+        if (budget > limit) budget = limit;
+    }
+    g_fcache.max_bytes = budget;
+    printf("Frame cache budget %zu bytes (%zu frames, usbfs_memory_mb=%ld)\n",
+           budget, frame_bytes ? budget / frame_bytes : 0, usbfs_mb);
 }
 
+/* return every frame to the pool (exit / before reconnecting) */
+static void frame_cache_release(void) {
+    for (int i = 0; i < FRAME_CACHE_MAX_ENTRIES; i++) {
+        frame_cache_entry_t *e = &g_fcache.entries[i];
+        if (e->frame) usb_monitor_frame_return(g_mon, e->frame);
+        e->frame = NULL; e->valid = 0;
+    }
+    g_fcache.bytes_in_use = 0;
+}
 
-static void LIBUSB_CALL transfer_callback(struct libusb_transfer *transfer) {
-    //printf("Callback Transfer completed: %d bytes\n", transfer->actual_length);
+static void frame_cache_report(FILE *out) {
+    uint64_t lookups = g_fcache.hits + g_fcache.misses;
+    int used = 0;
+    for (int i = 0; i < FRAME_CACHE_MAX_ENTRIES; i++) if (g_fcache.entries[i].valid) used++;
+    usb_monitor_stats_t st = { .struct_size = sizeof(st) };
+    usb_monitor_get_stats(g_mon, &st);
+    fprintf(out, "frame cache: hit=%llu miss=%llu hit_rate=%.1f%% dup_skip=%llu evict=%llu bypass=%llu "
+                 "entries=%d/%d mem=%zu/%zu bytes (pool %d frames, %d dev_mem, pinned %zu)\n",
+            (unsigned long long)g_fcache.hits, (unsigned long long)g_fcache.misses,
+            lookups ? 100.0 * (double)g_fcache.hits / (double)lookups : 0.0,
+            (unsigned long long)g_fcache.dup_skips, (unsigned long long)g_fcache.evictions,
+            (unsigned long long)g_fcache.bypass, used, FRAME_CACHE_MAX_ENTRIES,
+            g_fcache.bytes_in_use, g_fcache.max_bytes, st.frames, st.frames_dev_mem, st.bytes_pinned);
 }
-struct libusb_transfer *transfer = NULL;
-static int send_frame(libusb_device_handle *handle) {
-    int transferred;
-    int total_bytes = WIDTH * HEIGHT * 2; // RGB565 = 2 bytes/pixel
-    uint8_t *data = (uint8_t*)framebuffer;
-    int offset = 0;
 
-    /*
-    while (offset < total_bytes) {
-        int chunk = (total_bytes - offset > PACKET_SIZE) ? PACKET_SIZE : (total_bytes - offset);
-        int r = libusb_bulk_transfer(handle, EP_OUT, data + offset, chunk, &transferred, 1000);
-        if (r != 0) {
-            fprintf(stderr, "Bulk transfer error: %s\n", libusb_error_name(r));
-            return r;
+/* content id of the last frame actually handed to the device; a match skips the transfer entirely */
+static uint64_t last_sent_content = 0;
+static int last_sent_valid = 0;
+
+static uint64_t xfer_submit_us = 0;   // submit 시각, callback에서 latency 측정
+
+/* completion, run from usb_monitor_handle_events() */
+static void frame_done(usb_monitor_frame_t *frame, int status, int actual_length, void *user_data) {
+    (void)frame; (void)user_data;
+    latency_add(&g_xfer_latency, now_us() - xfer_submit_us);
+    capture_xfer_done(status, actual_length);
+    if (status != USB_MONITOR_FRAME_COMPLETED) last_sent_valid = 0; // 화면에 반영되지 않았을 수 있음
+}
+
+/* async submit; BUSY while the previous transfer is pending (frame dropped by the caller).
+ * content: content id of the payload; the capture slot filled for it (capture_frame_slot()) is
+ * recorded, or the frame is referenced if it was recorded recently */
+static int send_frame(usb_monitor_frame_t *frame, int keep, uint64_t content) {
+    if (usb_monitor_frame_busy(g_mon, frame)) { capture_frame_cancel(); return USB_MONITOR_ERROR_BUSY; }
+    xfer_submit_us = now_us();
+    int r = usb_monitor_frame_submit(g_mon, frame, keep ? USB_MONITOR_SUBMIT_KEEP : 0, frame_done, NULL);
+    if (r != 0) {
+        capture_frame_cancel();
+        if (r != USB_MONITOR_ERROR_BUSY && r != USB_MONITOR_ERROR_NO_DEVICE)
+            fprintf(stderr, "Submit transfer error: %s(%d) \n", usb_monitor_error_name(r), r);
+        return r;
+    }
+    capture_xfer_submit((int)usb_monitor_frame_size(frame));
+    capture_frame(content);
+    return 0;
+}
+
+
+/* ---------- layered compositor ---------- */
+
+/*
+ * Z-ordered layers on top of the canvas:
+ *   LAYER_BACKGROUND  opaque, own backing store
+ *   LAYER_WIDGETS     RGB565 + 8bit alpha, own backing store
+ *   LAYER_TEXT        RGB565 + 8bit alpha, written by the text renderer (glyph atlas blits)
+ *   sprites           small RGB565 + alpha images (cursor/overlay), moved every frame
+ * Static layers are drawn once; whenever one of them is invalidated only the dirty box of
+ * static_comp (background with widgets and text blended on top) is rebuilt. compositor_compose() then
+ * recomposites only the damaged boxes of the canvas: the old and new sprite positions plus the
+ * static dirty box, copied from static_comp and with the sprites blended over them. Everything
+ * else in the canvas is left as is, so the cost follows what changed. Every redrawn box marks
+ * its rows for canvas_key(), so the frame key is a hash of the composed pixels: a screen that
+ * returns to the same content gets the same key however it got there.
+ * The canvas must not be drawn by anything else while the compositor owns it.
+ */
+#define LAYER_BACKGROUND  0
+#define LAYER_WIDGETS     1
+#define LAYER_TEXT        2
+#define LAYER_COUNT       3
+#define SPRITE_RECT       0   // the moving rectangle
+#define SPRITE_CURSOR     1   // last touch position
+#define SPRITE_COUNT      2
+#define COMP_MAX_DAMAGE   (2 * SPRITE_COUNT + 1)
+
+#define CURSOR_SIZE       15
+#define COLOR_WIDGET      0x2945
+#define COLOR_WIDGET_EDGE 0x7BEF
+#define COLOR_CURSOR      0xFFFF
+
+typedef struct { int x0, y0, x1, y1; } box_t;   // [x0,x1) x [y0,y1)
+
+typedef struct {
+    uint16_t *px;
+    uint8_t  *alpha;     // NULL: opaque
+    box_t     dirty;
+    int       has_dirty;
+} layer_t;
+
+typedef struct {
+    uint16_t *px;
+    uint8_t  *alpha;
+    int w, h;
+    int x, y, visible;                  // requested
+    int drawn_x, drawn_y, drawn_visible; // what is in the canvas now
+} sprite_t;
+
+typedef struct {
+    int w, h;
+    layer_t   layers[LAYER_COUNT];
+    uint16_t *static_comp;
+    sprite_t  sprites[SPRITE_COUNT];
+    int       full_redraw;  // canvas content unknown (first frame)
+    uint64_t  frames, pixels;
+} compositor_t;
+static compositor_t g_comp;
+
+static inline int box_empty(const box_t *b) { return b->x0 >= b->x1 || b->y0 >= b->y1; }
+static inline box_t box_union(box_t a, box_t b) {
+    if (box_empty(&a)) return b;
+    if (box_empty(&b)) return a;
+    box_t r = { a.x0 < b.x0 ? a.x0 : b.x0, a.y0 < b.y0 ? a.y0 : b.y0,
+                a.x1 > b.x1 ? a.x1 : b.x1, a.y1 > b.y1 ? a.y1 : b.y1 };
+    return r;
+}
+static inline box_t box_intersect(box_t a, box_t b) {
+    box_t r = { a.x0 > b.x0 ? a.x0 : b.x0, a.y0 > b.y0 ? a.y0 : b.y0,
+                a.x1 < b.x1 ? a.x1 : b.x1, a.y1 < b.y1 ? a.y1 : b.y1 };
+    return r;
+}
+
+/*
+ * d = s*a + d*(1-a) for a span, per pixel alpha 0..255 (used with 5 bit precision, like the
+ * RGB565 fields). Pixels are spread to 0x07E0F81F (g in the high half, r/b in the low half) so
+ * one 32-bit multiply blends all three channels; the loop is branch free and gcc vectorizes it.
+ */
+static void blend565_span(uint16_t *restrict d, const uint16_t *restrict s, const uint8_t *restrict a, int n) {
+    for (int i = 0; i < n; i++) {
+        uint32_t al = ((uint32_t)a[i] + 4) >> 3;   // 0..32
+        uint32_t sx = ((uint32_t)s[i] | ((uint32_t)s[i] << 16)) & 0x07E0F81Fu;
+        uint32_t dx = ((uint32_t)d[i] | ((uint32_t)d[i] << 16)) & 0x07E0F81Fu;
+        uint32_t r = ((sx * al + dx * (32 - al)) >> 5) & 0x07E0F81Fu;
+        d[i] = (uint16_t)(r | (r >> 16));
+    }
+}
+
+static void layer_fill(layer_t *l, int stride, box_t b, uint16_t color, uint8_t alpha) {
+    for (int y = b.y0; y < b.y1; y++) {
+        fill565(l->px + (size_t)y * stride + b.x0, b.x1 - b.x0, color);
+        if (l->alpha) memset(l->alpha + (size_t)y * stride + b.x0, alpha, (size_t)(b.x1 - b.x0));
+    }
+}
+
+static void compositor_invalidate(int layer, box_t b) {
+    compositor_t *c = &g_comp;
+    box_t all = { 0, 0, c->w, c->h };
+    b = box_intersect(b, all);
+    if (box_empty(&b)) return;
+    layer_t *l = &c->layers[layer];
+    l->dirty = l->has_dirty ? box_union(l->dirty, b) : b;
+    l->has_dirty = 1;
+}
+
+static void compositor_free(void) {
+    compositor_t *c = &g_comp;
+    for (int i = 0; i < LAYER_COUNT; i++) { free(c->layers[i].px); free(c->layers[i].alpha); }
+    for (int i = 0; i < SPRITE_COUNT; i++) { free(c->sprites[i].px); free(c->sprites[i].alpha); }
+    free(c->static_comp);
+    memset(c, 0, sizeof(*c));
+}
+
+static int compositor_init(int w, int h) {
+    compositor_t *c = &g_comp;
+    memset(c, 0, sizeof(*c));
+    c->w = w; c->h = h;
+    size_t n = (size_t)w * h;
+    c->layers[LAYER_BACKGROUND].px = (uint16_t*)malloc(n * sizeof(uint16_t));
+    c->layers[LAYER_WIDGETS].px    = (uint16_t*)malloc(n * sizeof(uint16_t));
+    c->layers[LAYER_WIDGETS].alpha = (uint8_t*)calloc(n, 1);
+    c->layers[LAYER_TEXT].px       = (uint16_t*)malloc(n * sizeof(uint16_t));
+    c->layers[LAYER_TEXT].alpha    = (uint8_t*)calloc(n, 1);
+    c->static_comp = (uint16_t*)malloc(n * sizeof(uint16_t));
+    if (!c->layers[LAYER_BACKGROUND].px || !c->layers[LAYER_WIDGETS].px ||
+        !c->layers[LAYER_WIDGETS].alpha || !c->layers[LAYER_TEXT].px ||
+        !c->layers[LAYER_TEXT].alpha || !c->static_comp) { compositor_free(); return -1; }
+    c->full_redraw = 1;
+    return 0;
+}
+
+static int compositor_sprite_alloc(int id, int w, int h) {
+    sprite_t *s = &g_comp.sprites[id];
+    s->px = (uint16_t*)calloc((size_t)w * h, sizeof(uint16_t));
+    s->alpha = (uint8_t*)calloc((size_t)w * h, 1);
+    if (!s->px || !s->alpha) return -1;
+    s->w = w; s->h = h;
+    return 0;
+}
+
+static inline void compositor_move_sprite(int id, int x, int y, int visible) {
+    sprite_t *s = &g_comp.sprites[id];
+    s->x = x; s->y = y; s->visible = visible;
+}
+
+static inline box_t sprite_box(const sprite_t *s, int x, int y) {
+    box_t b = { x, y, x + s->w, y + s->h };
+    return b;
+}
+
+/* static_comp = background, widgets and text blended on top (dirty box only) */
+static void compositor_rebuild_static(box_t b) {
+    compositor_t *c = &g_comp;
+    const layer_t *bg = &c->layers[LAYER_BACKGROUND], *wg = &c->layers[LAYER_WIDGETS];
+    const layer_t *tx = &c->layers[LAYER_TEXT];
+    for (int y = b.y0; y < b.y1; y++) {
+        size_t o = (size_t)y * c->w + b.x0;
+        memcpy(c->static_comp + o, bg->px + o, (size_t)(b.x1 - b.x0) * 2);
+        blend565_span(c->static_comp + o, wg->px + o, wg->alpha + o, b.x1 - b.x0);
+        blend565_span(c->static_comp + o, tx->px + o, tx->alpha + o, b.x1 - b.x0);
+    }
+}
+
+/* canvas box = static_comp + sprites */
+static void compositor_redraw_box(box_t b) {
+    compositor_t *c = &g_comp;
+    for (int y = b.y0; y < b.y1; y++) {
+        size_t o = (size_t)y * c->w + b.x0;
+        memcpy(g_canvas.px + o, c->static_comp + o, (size_t)(b.x1 - b.x0) * 2);
+    }
+    for (int i = 0; i < SPRITE_COUNT; i++) {
+        const sprite_t *s = &c->sprites[i];
+        if (!s->visible) continue;
+        box_t sb = sprite_box(s, s->x, s->y);
+        box_t ib = box_intersect(sb, b);
+        if (box_empty(&ib)) continue;
+        for (int y = ib.y0; y < ib.y1; y++) {
+            size_t so = (size_t)(y - s->y) * s->w + (ib.x0 - s->x);
+            blend565_span(g_canvas.px + (size_t)y * c->w + ib.x0, s->px + so, s->alpha + so, ib.x1 - ib.x0);
         }
-        offset += transferred;
     }
-*/
-    //printf("trying to send\n");
+    c->pixels += (uint64_t)(b.x1 - b.x0) * (uint64_t)(b.y1 - b.y0);
+    canvas_key_invalidate(b.y0, b.y1);
+}
 
-    if(transfer) {
-        if(transfer->length==transfer->actual_length) {
-            //printf("Transfer completed, status: %d, length:%d actual_length:%d\n", transfer->status, transfer->length, transfer->actual_length);
-            libusb_free_transfer(transfer);
+/* bring the canvas up to date, touching only damaged boxes */
+static void compositor_compose(void) {
+    compositor_t *c = &g_comp;
+    box_t all = { 0, 0, c->w, c->h };
+    box_t damage[COMP_MAX_DAMAGE];
+    int nd = 0;
+
+    box_t static_dirty = { 0, 0, 0, 0 };
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        layer_t *l = &c->layers[i];
+        if (!l->has_dirty) continue;
+        static_dirty = box_union(static_dirty, l->dirty);
+        l->has_dirty = 0;
+    }
+    if (!box_empty(&static_dirty)) compositor_rebuild_static(static_dirty);
+
+    if (c->full_redraw) {
+        damage[nd++] = all;
+        c->full_redraw = 0;
+    } else {
+        if (!box_empty(&static_dirty)) damage[nd++] = static_dirty;
+        for (int i = 0; i < SPRITE_COUNT; i++) {
+            const sprite_t *s = &c->sprites[i];
+            if (s->visible == s->drawn_visible && s->x == s->drawn_x && s->y == s->drawn_y) continue;
+            box_t ob = s->drawn_visible ? sprite_box(s, s->drawn_x, s->drawn_y) : (box_t){0, 0, 0, 0};
+            box_t nb = s->visible ? sprite_box(s, s->x, s->y) : (box_t){0, 0, 0, 0};
+            box_t ov = box_intersect(ob, nb);
+            if (!box_empty(&ov)) damage[nd++] = box_union(ob, nb);   // 겹치면 하나로
+            else { damage[nd++] = ob; damage[nd++] = nb; }
         }
-        else {
-            printf("Transfer not completed, status: %d, length:%d actual_length:%d\n", transfer->status,transfer->length, transfer->actual_length);
-            if(check_usb_device_disconnected()){
-                return LIBUSB_ERROR_NO_DEVICE;
+    }
+    for (int i = 0; i < nd; i++) {
+        box_t b = box_intersect(damage[i], all);
+        if (!box_empty(&b)) compositor_redraw_box(b);
+    }
+    for (int i = 0; i < SPRITE_COUNT; i++) {
+        sprite_t *s = &c->sprites[i];
+        s->drawn_x = s->x; s->drawn_y = s->y; s->drawn_visible = s->visible;
+    }
+    c->frames++;
+}
+
+static void compositor_report(FILE *out) {
+    fprintf(out, "compositor: frames=%llu avg_recomposited=%.0f px/frame (canvas %d px)\n",
+            (unsigned long long)g_comp.frames,
+            g_comp.frames ? (double)g_comp.pixels / (double)g_comp.frames : 0.0, g_comp.w * g_comp.h);
+}
+
+/* ---------- glyph atlas + text rendering ---------- */
+
+/*
+ * Text is drawn into LAYER_TEXT from glyph atlases, one per (font, pixel size, colour). An atlas
+ * holds every glyph of the font pre-rasterized at that size: RGB565 colour plane plus 8 bit
+ * coverage, equal-width cells side by side (the inter-glyph gap is part of the cell). The bitmap
+ * font is box-filtered to the requested height, so non-integer scales get anti-aliased edges.
+ * Drawing a glyph is then two memcpy per row, and a label only rewrites the cells whose
+ * character changed; the touched cells are handed to the compositor as damage, so updating a
+ * couple of digits recomposites a few hundred pixels. Atlases are built on first use and kept
+ * in a small LRU cache.
+ */
+#define FONT_5X7           0
+#define FONT_FIRST         ' '
+#define FONT_LAST          '_'
+#define FONT_GLYPHS        (FONT_LAST - FONT_FIRST + 1)
+#define GLYPH_ATLAS_MAX    8
+#define TEXT_SIZE_MAX      128   // pixel height
+#define TEXT_LABEL_MAX     24    // chars per label
+
+/* 5x7 bitmap, one byte per row, bit 4 = leftmost column */
+static const uint8_t font5x7[FONT_GLYPHS][7] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+    { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 }, // '!'
+    { 0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00 }, // '"'
+    { 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A }, // '#'
+    { 0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04 }, // '$'
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // '%'
+    { 0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D }, // '&'
+    { 0x04, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00 }, // '''
+    { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // '('
+    { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // ')'
+    { 0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00 }, // '*'
+    { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 }, // '+'
+    { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 }, // ','
+    { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 }, // '-'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, // '.'
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // '/'
+    { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, // '0'
+    { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E }, // '1'
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, // '2'
+    { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E }, // '3'
+    { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, // '4'
+    { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E }, // '5'
+    { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, // '6'
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // '7'
+    { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, // '8'
+    { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C }, // '9'
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, // ':'
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 }, // ';'
+    { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, // '<'
+    { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 }, // '='
+    { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, // '>'
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, // '?'
+    { 0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E }, // '@'
+    { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 }, // 'A'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, // 'B'
+    { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, // 'C'
+    { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C }, // 'D'
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, // 'E'
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, // 'F'
+    { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, // 'G'
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // 'H'
+    { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, // 'I'
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, // 'J'
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // 'K'
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, // 'L'
+    { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, // 'M'
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // 'N'
+    { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // 'O'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, // 'P'
+    { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, // 'Q'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, // 'R'
+    { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, // 'S'
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // 'T'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // 'U'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, // 'V'
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, // 'W'
+    { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 }, // 'X'
+    { 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04 }, // 'Y'
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, // 'Z'
+    { 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E }, // '['
+    { 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 }, // 'backslash'
+    { 0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E }, // ']'
+    { 0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00 }, // '^'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F }, // '_'
+};
+
+typedef struct {
+    const uint8_t *rows;   // FONT_GLYPHS * h rows
+    int w, h;
+} font_t;
+static const font_t fonts[] = {
+    [FONT_5X7] = { &font5x7[0][0], 5, 7 },
+};
+#define FONT_COUNT ((int)(sizeof(fonts) / sizeof(fonts[0])))
+
+typedef struct {
+    int       valid;
+    int       font, size;      // key (with color)
+    uint16_t  color;
+    int       cell_w, cell_h;  // cell_w is also the advance
+    int       stride;          // FONT_GLYPHS * cell_w
+    uint16_t *px;
+    uint8_t  *alpha;
+    uint64_t  last_use;
+} glyph_atlas_t;
+
+static struct {
+    glyph_atlas_t atlas[GLYPH_ATLAS_MAX];
+    uint64_t tick, builds, hits;
+    uint64_t updates, glyphs, update_ns;
+} g_text;
+
+static inline int glyph_index(char ch) {
+    int c = (unsigned char)ch;
+    if (c >= 'a' && c <= 'z') c -= 'a' - 'A';   // 소문자는 대문자 glyph로
+    if (c < FONT_FIRST || c > FONT_LAST) c = '?';
+    return c - FONT_FIRST;
+}
+
+static void glyph_atlas_free(glyph_atlas_t *a) {
+    free(a->px); free(a->alpha);
+    memset(a, 0, sizeof(*a));
+}
+
+static void glyph_atlas_cache_free(void) {
+    for (int i = 0; i < GLYPH_ATLAS_MAX; i++) glyph_atlas_free(&g_text.atlas[i]);
+}
+
+/*
+ * Box filter: target pixel t covers [t*S, (t+1)*S) and source cell s covers [s*D, (s+1)*D) in
+ * units of 1/D source cells (S = source cells, D = target pixels along that axis). Coverage is
+ * the lit overlap area over the pixel area S_w * S_h.
+ */
+static void glyph_rasterize(const font_t *f, int g, int gw, int gh, uint8_t *alpha, int stride) {
+    const uint8_t *rows = f->rows + (size_t)g * f->h;
+    for (int ty = 0; ty < gh; ty++) {
+        for (int tx = 0; tx < gw; tx++) {
+            uint32_t cov = 0;
+            for (int sy = ty * f->h / gh; sy * gh < (ty + 1) * f->h; sy++) {
+                int y0 = ty * f->h > sy * gh ? ty * f->h : sy * gh;
+                int y1 = (ty + 1) * f->h < (sy + 1) * gh ? (ty + 1) * f->h : (sy + 1) * gh;
+                for (int sx = tx * f->w / gw; sx * gw < (tx + 1) * f->w; sx++) {
+                    if (!((rows[sy] >> (f->w - 1 - sx)) & 1)) continue;
+                    int x0 = tx * f->w > sx * gw ? tx * f->w : sx * gw;
+                    int x1 = (tx + 1) * f->w < (sx + 1) * gw ? (tx + 1) * f->w : (sx + 1) * gw;
+                    cov += (uint32_t)((x1 - x0) * (y1 - y0));
+                }
             }
-            else return 0;
+            uint32_t area = (uint32_t)(f->w * f->h);
+            alpha[(size_t)ty * stride + tx] = (uint8_t)((cov * 255 + area / 2) / area);
         }
     }
+}
 
-    transfer = libusb_alloc_transfer(0);
-    if (!transfer) {
-
-        //혹시 disconnect때문에 발생한것인지 check한다.
-        struct timeval tv = {0, 0};
-        int r=libusb_handle_events_timeout_completed(ctx, &tv, NULL);
-        if(r==LIBUSB_ERROR_NO_DEVICE)return r;
-        else {
-            fprintf(stderr, "Failed to allocate transfer\n");
-            return 1;
+/* atlas for (font, size, color): cached, built on a miss (evicts the least recently used) */
+static glyph_atlas_t *glyph_atlas_get(int font, int size, uint16_t color) {
+    if (font < 0 || font >= FONT_COUNT || size < 1 || size > TEXT_SIZE_MAX) return NULL;
+    glyph_atlas_t *victim = NULL;
+    for (int i = 0; i < GLYPH_ATLAS_MAX; i++) {
+        glyph_atlas_t *a = &g_text.atlas[i];
+        if (a->valid && a->font == font && a->size == size && a->color == color) {
+            a->last_use = ++g_text.tick;
+            g_text.hits++;
+            return a;
         }
+        if (!victim || (victim->valid && (!a->valid || a->last_use < victim->last_use))) victim = a;
     }
-    //printf("handle:%p transfer:%p, EP_OUT:0x%x, total_bytes:%d\n", handle, transfer, EP_OUT, total_bytes);
-    libusb_fill_bulk_transfer(transfer, handle, EP_OUT,
-                            data, total_bytes,
-                              transfer_callback, 0, 1000);
-    int r = libusb_submit_transfer(transfer);
-    if (r < 0) {
-        fprintf(stderr, "Submit transfer error: %s(%d) \n", libusb_error_name(r),r);
-        libusb_free_transfer(transfer);
-        return r;
+    glyph_atlas_free(victim);
+
+    const font_t *f = &fonts[font];
+    int gw = (size * f->w + f->h / 2) / f->h;
+    if (gw < 1) gw = 1;
+    glyph_atlas_t *a = victim;
+    a->cell_w = gw + (size + f->h - 1) / f->h;   // gap ~ one source column
+    a->cell_h = size;
+    a->stride = FONT_GLYPHS * a->cell_w;
+    size_t n = (size_t)a->stride * a->cell_h;
+    a->px = (uint16_t*)malloc(n * sizeof(uint16_t));
+    a->alpha = (uint8_t*)calloc(n, 1);
+    if (!a->px || !a->alpha) { glyph_atlas_free(a); return NULL; }
+    fill565(a->px, (int)n, color);
+    for (int g = 0; g < FONT_GLYPHS; g++)
+        glyph_rasterize(f, g, gw, size, a->alpha + (size_t)g * a->cell_w, a->stride);
+    a->font = font; a->size = size; a->color = color;
+    a->valid = 1;
+    a->last_use = ++g_text.tick;
+    g_text.builds++;
+    return a;
+}
+
+/* copy glyph g of the atlas into LAYER_TEXT at (x,y), clipped; g < 0 clears the cell */
+static box_t text_put_cell(const glyph_atlas_t *a, int g, int x, int y) {
+    compositor_t *c = &g_comp;
+    layer_t *l = &c->layers[LAYER_TEXT];
+    box_t cell = { x, y, x + a->cell_w, y + a->cell_h };
+    box_t b = box_intersect(cell, (box_t){ 0, 0, c->w, c->h });
+    if (box_empty(&b)) return (box_t){ 0, 0, 0, 0 };
+    size_t n = (size_t)(b.x1 - b.x0);
+    for (int yy = b.y0; yy < b.y1; yy++) {
+        size_t o = (size_t)yy * c->w + b.x0;
+        if (g < 0) { memset(l->alpha + o, 0, n); continue; }
+        size_t so = (size_t)(yy - y) * a->stride + (size_t)g * a->cell_w + (size_t)(b.x0 - x);
+        memcpy(l->px + o, a->px + so, n * sizeof(uint16_t));
+        memcpy(l->alpha + o, a->alpha + so, n);
     }
+    return b;
+}
 
+/* a single line of text at a fixed place and style; text[] is what LAYER_TEXT shows now */
+typedef struct {
+    int      x, y;
+    int      font, size;
+    uint16_t color;
+    char     text[TEXT_LABEL_MAX + 1];
+} text_label_t;
 
-    return 0;
+/*
+ * Change the label text. Only cells whose glyph differs are rewritten (trailing cells of a
+ * longer old string are cleared) and their bounding box is invalidated; returns that box.
+ * The style must not change once the label has been drawn.
+ */
+static box_t text_label_set(text_label_t *t, const char *s) {
+    box_t damage = { 0, 0, 0, 0 };
+    uint64_t t0 = now_ns();
+    size_t n_old = strlen(t->text), n_new = strnlen(s, TEXT_LABEL_MAX);
+    if (n_old == n_new && memcmp(t->text, s, n_new) == 0) return damage;
+    const glyph_atlas_t *a = glyph_atlas_get(t->font, t->size, t->color);
+    if (!a) return damage;
+    size_t n = n_old > n_new ? n_old : n_new;
+    for (size_t i = 0; i < n; i++) {
+        int x = t->x + (int)i * a->cell_w;
+        if (i >= n_new) {
+            damage = box_union(damage, text_put_cell(a, -1, x, t->y));
+        } else if (i >= n_old || glyph_index(s[i]) != glyph_index(t->text[i])) {
+            damage = box_union(damage, text_put_cell(a, glyph_index(s[i]), x, t->y));
+            g_text.glyphs++;
+        }
+    }
+    memcpy(t->text, s, n_new);
+    t->text[n_new] = '\0';
+    if (!box_empty(&damage)) compositor_invalidate(LAYER_TEXT, damage);
+    g_text.updates++;
+    g_text.update_ns += now_ns() - t0;
+    return damage;
 }
 
+static void text_report(FILE *out) {
+    size_t bytes = 0;
+    int n = 0;
+    for (int i = 0; i < GLYPH_ATLAS_MAX; i++) {
+        const glyph_atlas_t *a = &g_text.atlas[i];
+        if (!a->valid) continue;
+        n++;
+        bytes += (size_t)a->stride * a->cell_h * 3;
+    }
+    fprintf(out, "text: updates=%llu glyph_blits=%llu avg_update=%.2f us atlases=%d (%zu KB) "
+                 "atlas_builds=%llu atlas_hits=%llu\n",
+            (unsigned long long)g_text.updates, (unsigned long long)g_text.glyphs,
+            g_text.updates ? (double)g_text.update_ns / 1000.0 / (double)g_text.updates : 0.0,
+            n, bytes / 1024, (unsigned long long)g_text.builds, (unsigned long long)g_text.hits);
+}
 
-/* libusb connect (first matching device) */
-static int connect_device_inner(void) {
-    libusb_device **devs = NULL;
-    ssize_t cnt = libusb_get_device_list(ctx, &devs);
-    if (cnt < 0) return (int)cnt;
-    libusb_device *target = NULL;
-    for (ssize_t i=0;i<cnt;i++){
-        libusb_device *d = devs[i];
-        struct libusb_device_descriptor desc;
-        if (libusb_get_device_descriptor(d, &desc) < 0) continue;
-        if (desc.idVendor == VENDOR_ID && desc.idProduct == PRODUCT_ID) { libusb_ref_device(d); target = d; break; }
-    }
-    libusb_free_device_list(devs, 1);
-    if (!target) return 1;
-    if (handle) {
-        if (interface_claimed_screen) {
-            libusb_release_interface(handle, USB_SCREEN_INTERFACE_NUM);
-            interface_claimed_screen = 0;
-            if (kernel_attached_screen) { libusb_attach_kernel_driver(handle, USB_SCREEN_INTERFACE_NUM); kernel_attached_screen = 0; }
-        }
-        libusb_close(handle); handle = NULL;
-    }
-    int r = libusb_open(target, &handle);
-    libusb_unref_device(target);
-    if (r != 0) { fprintf(stderr,"libusb_open failed: %s (%d)\n", libusb_error_name(r), r); return 1; }
-    if (libusb_kernel_driver_active(handle, USB_SCREEN_INTERFACE_NUM) == 1) {
-        if (libusb_detach_kernel_driver(handle, USB_SCREEN_INTERFACE_NUM) == 0) kernel_attached_screen = 1;
-        else kernel_attached_screen = 0;
-    }
-    if (libusb_claim_interface(handle, USB_SCREEN_INTERFACE_NUM) < 0) {
-        fprintf(stderr, "Failed to claim screen interface %d\n", USB_SCREEN_INTERFACE_NUM);
-        libusb_close(handle); handle = NULL; return 1;
-    }
-    interface_claimed_screen = 1;
-    // optional offset reset
-    usb_monitor_control_response_t resp;
-    (void)libusb_control_transfer(handle,
-        LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
-        SCREEN_REQUEST_TYPE_OFFSET_RESET, 0, USB_SCREEN_INTERFACE_NUM,
-        (unsigned char *)&resp, sizeof(resp), 500);
+/*
+ * Dashboard labels drawn into the widget panels. The values change every DASH_UPDATE_US (and
+ * on every touch move), so their rows are kept out of the frame cache key: a cached frame is
+ * reused for the rest of the screen and only the value rows (out_y0..out_y1 of the logical
+ * frame) are presented again into its payload after the lookup.
+ */
+#define DASH_PANELS        3
+#define DASH_UPDATE_US     500000ULL
+#define COLOR_TEXT_CAPTION 0xB596
+#define COLOR_TEXT_VALUE   0xFFFF
+
+static struct {
+    text_label_t caption[DASH_PANELS], value[DASH_PANELS];
+    uint64_t last_us, frames_sent, last_frames;
+    int value_y0, value_y1;   // canvas rows of the value labels
+    int out_y0, out_y1;       // logical output rows showing them
+} g_dash;
+
+/* demo scene: gradient + grid background, translucent widget panels with dashboard text,
+ * rectangle and cursor sprites */
+static int demo_scene_init(void) {
+    compositor_t *c = &g_comp;
+    if (compositor_init(g_canvas.w, g_canvas.h) != 0) return -1;
+    if (compositor_sprite_alloc(SPRITE_RECT, RECT_W, RECT_H) != 0 ||
+        compositor_sprite_alloc(SPRITE_CURSOR, CURSOR_SIZE, CURSOR_SIZE) != 0) { compositor_free(); return -1; }
+
+    layer_t *bg = &c->layers[LAYER_BACKGROUND];
+    for (int y = 0; y < c->h; y++) {
+        uint16_t *line = bg->px + (size_t)y * c->w;
+        uint16_t shade = (uint16_t)((y * 12 / c->h) & 0x1F);     // dark blue gradient
+        fill565(line, c->w, shade);
+        if (y % 40 == 0) fill565(line, c->w, 0x18E3);             // grid
+        else for (int x = 0; x < c->w; x += 40) line[x] = 0x18E3;
+    }
+    compositor_invalidate(LAYER_BACKGROUND, (box_t){ 0, 0, c->w, c->h });
+
+    // three translucent panels along the bottom
+    layer_t *wg = &c->layers[LAYER_WIDGETS];
+    int pw = c->w / 4, ph = c->h / 5, gap = (c->w - 3 * pw) / 4;
+    int margin = gap / 2 < ph / 2 ? gap / 2 : ph / 2;   // 가로로 긴 --source에서도 canvas 안에
+    for (int i = 0; i < 3; i++) {
+        box_t p = { gap + i * (pw + gap), c->h - ph - margin, gap + i * (pw + gap) + pw, c->h - margin };
+        layer_fill(wg, c->w, p, COLOR_WIDGET_EDGE, 255);
+        box_t in = { p.x0 + 2, p.y0 + 2, p.x1 - 2, p.y1 - 2 };
+        layer_fill(wg, c->w, in, COLOR_WIDGET, 160);
+        compositor_invalidate(LAYER_WIDGETS, p);
+
+        static const char *captions[DASH_PANELS] = { "FRAMES/S", "CACHE HIT", "TOUCH" };
+        int cs = ph / 6, vs = ph * 2 / 7;
+        if (cs > TEXT_SIZE_MAX) cs = TEXT_SIZE_MAX;
+        if (vs > TEXT_SIZE_MAX) vs = TEXT_SIZE_MAX;
+        g_dash.caption[i] = (text_label_t){ p.x0 + 8, p.y0 + 6, FONT_5X7, cs, COLOR_TEXT_CAPTION, "" };
+        g_dash.value[i]   = (text_label_t){ p.x0 + 8, p.y0 + 6 + cs + cs / 2, FONT_5X7, vs, COLOR_TEXT_VALUE, "" };
+        text_label_set(&g_dash.caption[i], captions[i]);
+        text_label_set(&g_dash.value[i], "--");
+        g_dash.value_y0 = g_dash.value[i].y;
+        g_dash.value_y1 = g_dash.value[i].y + vs;
+    }
+    g_dash.last_us = now_us();
+
+    // rectangle sprite: solid centre, soft 4px edge
+    sprite_t *r = &c->sprites[SPRITE_RECT];
+    for (int y = 0; y < r->h; y++) for (int x = 0; x < r->w; x++) {
+        int e = x < y ? x : y;
+        if (r->w - 1 - x < e) e = r->w - 1 - x;
+        if (r->h - 1 - y < e) e = r->h - 1 - y;
+        r->px[y * r->w + x] = COLOR_RECT;
+        r->alpha[y * r->w + x] = (uint8_t)(e >= 4 ? 230 : 60 + e * 40);
+    }
+    // cursor sprite: crosshair
+    sprite_t *cu = &c->sprites[SPRITE_CURSOR];
+    for (int i = 0; i < CURSOR_SIZE; i++) {
+        int m = CURSOR_SIZE / 2;
+        cu->px[m * CURSOR_SIZE + i] = COLOR_CURSOR; cu->alpha[m * CURSOR_SIZE + i] = 255;
+        cu->px[i * CURSOR_SIZE + m] = COLOR_CURSOR; cu->alpha[i * CURSOR_SIZE + m] = 255;
+    }
     return 0;
 }
+
+/* value rows out of the cache key (after canvas_key_init() and the scaler are set up) */
+static void dashboard_bind_key(void) {
+    canvas_key_exclude_rows(g_dash.value_y0, g_dash.value_y1);
+    g_dash.out_y0 = g_ckey.skip_y0; g_dash.out_y1 = g_ckey.skip_y1;
+    if (g_scaler.active)
+        scaler_source_rows_to_output(&g_scaler, g_ckey.skip_y0, g_ckey.skip_y1, &g_dash.out_y0, &g_dash.out_y1);
+}
+
+/* refresh the dashboard numbers; labels skip unchanged text, so this is cheap every frame */
+static void dashboard_update(uint64_t now) {
+    char buf[TEXT_LABEL_MAX + 1];
+    if (now - g_dash.last_us >= DASH_UPDATE_US) {
+        double dt = (double)(now - g_dash.last_us) / 1e6;
+        snprintf(buf, sizeof(buf), "%.1f", (double)(g_dash.frames_sent - g_dash.last_frames) / dt);
+        text_label_set(&g_dash.value[0], buf);
+        uint64_t lookups = g_fcache.hits + g_fcache.misses;
+        snprintf(buf, sizeof(buf), "%.0f%%", lookups ? 100.0 * (double)g_fcache.hits / (double)lookups : 0.0);
+        text_label_set(&g_dash.value[1], buf);
+        g_dash.last_frames = g_dash.frames_sent;
+        g_dash.last_us = now;
+    }
+    if (g_touch.has_pos) snprintf(buf, sizeof(buf), "%d,%d", g_touch.last_x, g_touch.last_y);
+    else snprintf(buf, sizeof(buf), "--");
+    text_label_set(&g_dash.value[2], buf);
+}
+
 static volatile sig_atomic_t keep_running = 1;
 static void handle_signal(int sig) { (void)sig; keep_running = 0; }
 static int connect_device(void) {
     while (keep_running) {
-        int r = connect_device_inner();
+        int r = usb_monitor_connect(g_mon);
         if (r == 0) return 0;
         fprintf(stderr, "Waiting for 1fc9:8335 device (connect_device)...\n");
         sleep(1);
@@ -549,62 +1878,119 @@ static int connect_device(void) {
     return 1;
 }
 
-/* time util */
-static inline uint64_t now_us(void) {
-    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000ULL;
-}
 
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s [--source WxH] [--scale nearest|bilinear|box] [--rotate 0|90|180|270]\n"
+        "          [--cache-mb N] [--record FILE] [--replay FILE | --replay-frames FILE] [/dev/input/eventN]\n"
+        "  --source WxH          render at WxH and fit it onto the panel (letterboxed)\n"
+        "  --scale MODE          resampling filter for --source (default bilinear)\n"
+        "  --rotate DEG          rotate the picture clockwise on the panel (90/270: portrait)\n"
+        "  --cache-mb N          frame cache size in MiB (default 12, capped below usbfs_memory_mb, 0: off)\n"
+        "  --record FILE         write frames, transfer events and touch events to FILE\n"
+        "  --replay FILE         feed recorded touch events to the live pipeline on their original timeline\n"
+        "  --replay-frames FILE  re-submit recorded frames on their original timeline\n", prog);
+}
 
 /* main */
 int main(int argc, char *argv[]) {
     const char *explicit_event_path = NULL;
-    if (argc >= 2) explicit_event_path = argv[1];
+    const char *record_path = NULL, *replay_path = NULL;
+    int replay_mode = REPLAY_NONE;
+    int src_w = 0, src_h = 0, scale_mode = SCALE_BILINEAR, rotation = 0;
+    size_t cache_bytes = FRAME_CACHE_MAX_BYTES;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--source") == 0 && i + 1 < argc) {
+            // 사각형이 canvas 안에서 움직일 수 있어야 한다 (rand() % (w - RECT_W), clamp_rect)
+            if (sscanf(argv[++i], "%dx%d", &src_w, &src_h) != 2 ||
+                src_w < SCALE_MIN_DIM || src_h < SCALE_MIN_DIM || src_w > SCALE_MAX_DIM || src_h > SCALE_MAX_DIM ||
+                src_w <= RECT_W || src_h <= RECT_H) {
+                fprintf(stderr, "invalid --source %s (min %dx%d, max %dx%d)\n", argv[i],
+                        RECT_W + 1, RECT_H + 1, SCALE_MAX_DIM, SCALE_MAX_DIM);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            const char *m = argv[++i];
+            if (strcmp(m, "nearest") == 0) scale_mode = SCALE_NEAREST;
+            else if (strcmp(m, "bilinear") == 0) scale_mode = SCALE_BILINEAR;
+            else if (strcmp(m, "box") == 0) scale_mode = SCALE_BOX;
+            else { usage(argv[0]); return 1; }
+        }
+        else if (strcmp(argv[i], "--rotate") == 0 && i + 1 < argc) {
+            rotation = atoi(argv[++i]);
+            if (rotation_init(rotation) != 0) { fprintf(stderr, "invalid --rotate %s\n", argv[i]); return 1; }
+        }
+        else if (strcmp(argv[i], "--cache-mb") == 0 && i + 1 < argc) {
+            int mb = atoi(argv[++i]);
+            if (mb < 0 || mb > 1024) { fprintf(stderr, "invalid --cache-mb %s\n", argv[i]); return 1; }
+            cache_bytes = (size_t)mb * 1024u * 1024u;
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) record_path = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) { replay_path = argv[++i]; replay_mode = REPLAY_INPUT; }
+        else if (strcmp(argv[i], "--replay-frames") == 0 && i + 1 < argc) { replay_path = argv[++i]; replay_mode = REPLAY_FRAMES; }
+        else if (argv[i][0] == '-') { usage(argv[0]); return 1; }
+        else explicit_event_path = argv[i];
+    }
 
     signal(SIGINT, handle_signal); signal(SIGTERM, handle_signal);
 
+    if (!src_w) { src_w = g_logical_w; src_h = g_logical_h; }
+    if (src_w != g_logical_w || src_h != g_logical_h || rotation != 0) {
+        // canvas는 별도 버퍼 (회전은 in-place 불가)
+        g_canvas.px = (uint16_t*)malloc((size_t)src_w * src_h * sizeof(uint16_t));
+        if (!g_canvas.px) { fprintf(stderr, "failed to allocate %dx%d canvas\n", src_w, src_h); return 1; }
+        g_canvas.w = src_w; g_canvas.h = src_h;
+    }
+    if (src_w != g_logical_w || src_h != g_logical_h) {
+        if (scaler_init(&g_scaler, src_w, src_h, g_logical_w, g_logical_h, scale_mode) != 0) {
+            fprintf(stderr, "failed to set up %dx%d source\n", src_w, src_h); return 1;
+        }
+        printf("Source %dx%d -> panel %dx%d at (%d,%d), %s\n", src_w, src_h,
+               g_scaler.dst_w, g_scaler.dst_h, g_scaler.dst_x, g_scaler.dst_y, scale_mode_name(g_scaler.mode));
+    }
+    if (rotation) printf("Rotation %d (logical %dx%d)\n", rotation, g_logical_w, g_logical_h);
+    if (demo_scene_init() != 0 || canvas_key_init() != 0) { fprintf(stderr, "failed to set up compositor\n"); return 1; }
+    dashboard_bind_key();
+
+    uint32_t rand_seed = (uint32_t)time(NULL);
+    if (replay_path && replay_open(replay_path, replay_mode, &rand_seed) != 0) return 1;
+
     #ifdef AUTO_RANDOM_MOVE
-    srand((unsigned)time(NULL));          // <<< ADDED: rand() 시드
+    srand(rand_seed);                     // <<< ADDED: rand() 시드 (replay시 capture의 seed 사용)
     #endif
 
-    if (libusb_init(&ctx) < 0) { fprintf(stderr,"libusb init failed\n"); return 1; }
-    if (connect_device() != 0) { fprintf(stderr,"Device connect failed\n"); libusb_exit(ctx); return 1; }
+    usb_monitor_config_t cfg;
+    usb_monitor_config_init(&cfg);
+    cfg.width = WIDTH; cfg.height = HEIGHT;
+    cfg.max_frames = FRAME_POOL_FRAMES;
+    cfg.max_in_flight = 1;   // 이전 transfer가 끝나기 전의 frame은 버린다
+    int r = usb_monitor_open(&cfg, &g_mon);
+    if (r != 0) { fprintf(stderr,"libusbmonitor init failed: %s\n", usb_monitor_error_name(r)); return 1; }
+    if (connect_device() != 0) { fprintf(stderr,"Device connect failed\n"); usb_monitor_close(g_mon); return 1; }
     printf("Connected to USB screen on device 1fc9:8335\n");
+    frame_cache_set_budget(cache_bytes, usb_monitor_frame_bytes(g_mon));
 
-    char event_path[PATH_MAX] = {0};
-    // first try to find the event node belonging to the same libusb device
-    if (find_event_for_libusb_device(handle, event_path, sizeof(event_path)) == 0) {
-        printf("Found matching event node for this USB device: %s\n", event_path);
-    } else if (explicit_event_path) {
-        strncpy(event_path, explicit_event_path, sizeof(event_path)-1);
-        event_path[sizeof(event_path)-1] = '\0';
-    } else {
-        // fallback autodetect (any ABS-capable event)
-        if (autodetect_touch_event_path(event_path, sizeof(event_path)) == 0) {
-            printf("Autodetected touch event device (fallback): %s\n", event_path);
-        } else {
-            fprintf(stderr,"Failed to find touch event for device and fallback autodetect failed\n");
-            if (interface_claimed_screen) { libusb_release_interface(handle, USB_SCREEN_INTERFACE_NUM); interface_claimed_screen=0; }
-            if (handle) libusb_close(handle);
-            libusb_exit(ctx);
+    if (replay_mode == REPLAY_NONE) {
+        // event node of the same USB device, else explicit path, else any ABS-capable node
+        r = usb_monitor_touch_open(g_mon, explicit_event_path);
+        if (r != 0) {
+            fprintf(stderr,"Failed to open touch event device: %s\n", usb_monitor_error_name(r));
+            usb_monitor_close(g_mon);
             return 1;
         }
-    }
+        g_touch.dec.struct_size = sizeof(g_touch.dec);
+        usb_monitor_touch_get_decoder(g_mon, &g_touch.dec);
+        printf("Touch device %s opened. have_mt=%d have_st=%d absX=[%d..%d] absY=[%d..%d]\n",
+               usb_monitor_touch_path(g_mon), g_touch.dec.have_mt, g_touch.dec.have_st,
+               g_touch.dec.abs_min_x, g_touch.dec.abs_max_x, g_touch.dec.abs_min_y, g_touch.dec.abs_max_y);
+    } // replay_mode == REPLAY_NONE
 
-    // open libevdev on found event node
-    if (open_touch_device_by_libevdev(&touch_info, event_path) != 0) {
-        perror("open_touch_device_by_libevdev");
-        if (interface_claimed_screen) { libusb_release_interface(handle, USB_SCREEN_INTERFACE_NUM); interface_claimed_screen=0; }
-        if (handle) libusb_close(handle);
-        libusb_exit(ctx);
-        return 1;
-    }
-    init_touch_caps_from_dev(touch_info.dev);
-    printf("Touch device opened. have_mt=%d have_st=%d absX=[%d..%d] absY=[%d..%d]\n",
-           g_touch.have_mt, g_touch.have_st, g_touch.abs_min_x, g_touch.abs_max_x, g_touch.abs_min_y, g_touch.abs_max_y);
+    if (record_path) capture_start(record_path, rand_seed);   // 실패해도 streaming은 계속
 
-    Rect rect = { (WIDTH-RECT_W)/2, (HEIGHT-RECT_H)/2 }, target_rect = rect;
+    Rect rect = { (g_canvas.w-RECT_W)/2, (g_canvas.h-RECT_H)/2 }, target_rect = rect;
     uint64_t last_frame = now_us();
+    uint64_t last_cache_report = last_frame;
 
     #ifdef AUTO_RANDOM_MOVE
     uint64_t now0 = now_us();             // <<< ADDED
@@ -615,14 +2001,15 @@ int main(int argc, char *argv[]) {
     printf("Streaming frames; rectangle follows touch.\n");
 
     while (keep_running) {
-        struct timeval tv = {0,0};
-        int r = libusb_handle_events_timeout_completed(ctx, &tv, NULL);
-        if (r == LIBUSB_ERROR_NO_DEVICE) {
+        r = usb_monitor_handle_events(g_mon, 0);   // completions -> frame_done()
+        if (r == USB_MONITOR_ERROR_NO_DEVICE) {
             fprintf(stderr,"USB device disappeared; reconnecting...\n");
+            frame_cache_release();   // 새 handle의 dev_mem으로 다시 할당되도록 pool에 반환
+            last_sent_valid = 0;
             if (connect_device() != 0) break;
             continue;
         } else if (r != 0) {
-            fprintf(stderr,"libusb_handle_events error: %s (%d)\n", libusb_error_name(r), r);
+            fprintf(stderr,"usb_monitor_handle_events error: %s (%d)\n", usb_monitor_error_name(r), r);
             break;
         }
 
@@ -630,11 +2017,15 @@ int main(int argc, char *argv[]) {
         g_touch.updated = 0;  // <<< ADDED: 이 프레임에서 새로운 터치 갱신 여부 초기화
         #endif
 
-        struct input_event ev; int rc;
-        do {
-            rc = libevdev_next_event(touch_info.dev, LIBEVDEV_READ_FLAG_NORMAL, &ev);
-            if (rc == LIBEVDEV_READ_STATUS_SUCCESS || rc == LIBEVDEV_READ_STATUS_SYNC) update_touch_from_event(&ev);
-        } while (rc == LIBEVDEV_READ_STATUS_SUCCESS || rc == LIBEVDEV_READ_STATUS_SYNC);
+        if (replay_mode != REPLAY_NONE) {
+            if (replay_pump(now_us()) < 0) { printf("Replay finished\n"); break; }
+        } else {
+            struct input_event ev;
+            while (usb_monitor_touch_next(g_mon, &ev) > 0) {
+                capture_evdev(&ev);
+                update_touch_from_event(&ev);
+            }
+        }
 
         #ifdef AUTO_RANDOM_MOVE
         uint64_t now = now_us();   // <<< ADDED: 현재 시각
@@ -652,8 +2043,8 @@ int main(int argc, char *argv[]) {
         if (!g_touch.updated) {   // 이번 프레임에 실제 터치 갱신이 없을 때만 자동 입력 사용
             if (now - last_user_input_us >= AUTO_INTERVAL_US &&
                 now - last_auto_gen_us   >= AUTO_INTERVAL_US) {
-                int rx = rand() % (WIDTH  - RECT_W);
-                int ry = rand() % (HEIGHT - RECT_H);
+                int rx = rand() % (g_canvas.w - RECT_W);
+                int ry = rand() % (g_canvas.h - RECT_H);
                 target_rect.x = rx;
                 target_rect.y = ry;
                 clamp_rect(&target_rect);
@@ -685,21 +2076,68 @@ int main(int argc, char *argv[]) {
 
         last_frame = now_us();
 
-        clear_framebuffer();
-        draw_rectangle(&rect);
+        if (last_frame - last_cache_report >= FRAME_CACHE_REPORT_US) {
+            frame_cache_report(stdout);
+            compositor_report(stdout);
+            text_report(stdout);
+            last_cache_report = last_frame;
+        }
 
-        if (!handle) {
-             //연결이 끊어지면 재연결하지 않고 종료함.
-            break;
-            //fprintf(stderr,"Warning: handle NULL before send_frame_sync\n");
-            //if (connect_device() != 0) break;
+        uint64_t key, content;   // cache key, content id of everything sent
+        if (replay_mode == REPLAY_FRAMES) {
+            if (!g_replay.frame_ready) continue;   // 다음 recorded frame 시각 전
+            g_replay.frame_ready = 0;
+            key = content = g_replay.show_key;   // content key recorded with the frame
+        } else {
+            dashboard_update(last_frame);
+            compositor_move_sprite(SPRITE_RECT, rect.x, rect.y, 1);
+            compositor_move_sprite(SPRITE_CURSOR, g_touch.last_x - CURSOR_SIZE/2, g_touch.last_y - CURSOR_SIZE/2, g_touch.has_pos);
+            compositor_compose();   // damage 영역만 다시 합성
+            key = canvas_key(&content);   // 다시 그린 row만 hash, dashboard 값 row는 key에서 제외
+        }
+        if (last_sent_valid && content == last_sent_content) {
+            // 화면에 이미 떠 있는 프레임과 동일 -> transfer 생략
+            g_fcache.dup_skips++;
+            continue;
         }
+
+        frame_cache_entry_t *fe = frame_cache_lookup(key);
+        usb_monitor_frame_t *frame;
+        if (fe) {
+            frame = fe->frame;   // cache hit: raster/conversion 생략
+            if (usb_monitor_frame_busy(g_mon, frame)) continue;   // still in flight: drop this frame
+            if (replay_mode != REPLAY_FRAMES && g_dash.out_y0 < g_dash.out_y1)   // dashboard 값 row만 갱신
+                present_rows((uint16_t*)usb_monitor_frame_data(frame), g_dash.out_y0, g_dash.out_y1);
+            // capture: the payload is a function of the canvas, so it is presented again into
+            // the slot rather than read back from DMA memory
+            uint16_t *snap = capture_frame_slot(content);
+            if (snap) {
+                if (replay_mode == REPLAY_FRAMES) memcpy(snap, g_replay.show, FRAME_BYTES);
+                else present_frame(snap);
+            }
+        } else {
+            fe = frame_cache_reserve(key);
+            // bypass: scratch frame, back to the pool once transferred
+            frame = fe ? fe->frame : usb_monitor_frame_borrow(g_mon);
+            if (!frame) continue;   // pool exhausted: drop this frame
+            uint16_t *dst = (uint16_t*)usb_monitor_frame_data(frame);   // filled in place, no copy
+            uint16_t *snap = capture_frame_slot(content);   // recording: cached copy for the writer
+            if (replay_mode == REPLAY_FRAMES) {
+                memcpy(dst, g_replay.show, FRAME_BYTES);   // recorded frame is already transfer-ready
+                if (snap) memcpy(snap, g_replay.show, FRAME_BYTES);
+            } else if (snap) {
+                present_frame(snap);   // render once into cached memory, DMA memory is only written
+                memcpy(dst, snap, FRAME_BYTES);
+            } else {
+                present_frame(dst);   // canvas -> panel (scale/letterbox or copy)
+            }
+        }
+
         #if 0
-        int sr = send_frame_sync(handle);
+        int sr = usb_monitor_send_sync(g_mon, usb_monitor_frame_data(frame), FRAME_BYTES);
         #else
-        struct timeval tvTmp0 = {0, 0};
-        r=libusb_handle_events_timeout_completed(ctx, &tvTmp0, NULL); // usb 이벤트를 먼저 처리해줘야, 이전 transfer가 완료된것으로 libusb내부값이 변경된다.
-        if(r==LIBUSB_ERROR_NO_DEVICE){
+        r = usb_monitor_handle_events(g_mon, 0); // usb 이벤트를 먼저 처리해줘야, 이전 transfer가 완료된것으로 반영된다.
+        if(r==USB_MONITOR_ERROR_NO_DEVICE){
             //연결이 끊어지면 재연결하지 않고 종료함.
             break;
             //printf("USB device disconnected, reconnecting... A\n");
@@ -707,34 +2145,44 @@ int main(int argc, char *argv[]) {
             //continue; // 재연결 후 루프 시작
         }
         else if(r!=0) {
-            fprintf(stderr, "libusb_handle_events error: %s\n", libusb_error_name(r));
+            fprintf(stderr, "usb_monitor_handle_events error: %s\n", usb_monitor_error_name(r));
             break; // 에러 발생시 루프 종료
         }
-        #endif
 
-        int sr = send_frame(handle);
-        if (sr == LIBUSB_ERROR_NO_DEVICE) {
+        int sr = send_frame(frame, fe != NULL, content);
+        if (sr != 0 && !fe) usb_monitor_frame_return(g_mon, frame);
+        #endif
+        if (sr == USB_MONITOR_ERROR_NO_DEVICE) {
              //연결이 끊어지면 재연결하지 않고 종료함.
              break;
             //fprintf(stderr,"Device gone during send; reconnecting...\n");
             //if (connect_device() != 0) break;
             //continue;
+        } else if (sr == USB_MONITOR_ERROR_BUSY) {
+            // 이전 transfer가 아직 진행 중: 이번 프레임은 버린다.
         } else if (sr != 0) {
-            fprintf(stderr,"send_frame_sync returned %d\n", sr);
+            fprintf(stderr,"send_frame returned %d\n", sr);
             break;
+        } else {
+            last_sent_content = content;
+            last_sent_valid = 1;
+            g_dash.frames_sent++;
         }
     }
 
     /* cleanup */
     keep_running = 0;
-    if (interface_claimed_screen && handle) {
-        libusb_release_interface(handle, USB_SCREEN_INTERFACE_NUM);
-        if (kernel_attached_screen) libusb_attach_kernel_driver(handle, USB_SCREEN_INTERFACE_NUM);
-        interface_claimed_screen = 0; kernel_attached_screen = 0;
-    }
-    if (handle) libusb_close(handle);
-    libusb_exit(ctx);
-
-    close_touch_device_by_libevdev(&touch_info);
+    capture_stop();
+    replay_close();
+    frame_cache_report(stdout);
+    compositor_report(stdout);
+    text_report(stdout);
+    frame_cache_release();
+    compositor_free();
+    canvas_key_free();
+    glyph_atlas_cache_free();
+    if (g_scaler.active) scaler_free(&g_scaler);
+    if (g_canvas.px != &framebuffer[0][0]) free(g_canvas.px);
+    usb_monitor_close(g_mon);   // interface release, touch close, libusb exit
     return 0;
 }
@@ -0,0 +1,874 @@
+// ===== usb_monitor.c: libusbmonitor =====
+// Connect/discovery, control requests, zero-copy asynchronous frame submission and touch input
+// for the 1fc9:8335 USB monitor. The evdev node is matched to the same physical USB device
+// opened by libusb (by matching idVendor/idProduct and optional serial).
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <libusb-1.0/libusb.h>
+#include <libevdev/libevdev.h>
+
+#include "usb_monitor.h"
+
+#define PACKET_SIZE              1024   // chunk size of usb_monitor_send_sync()
+#define TOUCH_EVENT_SCAN_MAX     64     // scan this many event nodes (0..63)
+#define CONTROL_TIMEOUT_MS       500
+#define EVENT_THREAD_POLL_US     100000
+#define QUIESCE_MAX_ROUNDS       200    // x 10ms: wait for cancelled transfers on reconnect/close
+
+#define DEFAULT_MAX_FRAMES       4
+#define DEFAULT_MAX_IN_FLIGHT    1
+#define DEFAULT_TIMEOUT_MS       1000
+
+/* smallest struct_size accepted: the fields of the first released layout */
+#define CONFIG_SIZE_MIN  (offsetof(usb_monitor_config_t, event_thread) + sizeof(int))
+#define STATS_SIZE_MIN   (offsetof(usb_monitor_stats_t, busy) + sizeof(uint64_t))
+#define TOUCH_SIZE_MIN   (offsetof(usb_monitor_touch_t, pending_y) + sizeof(int))
+
+enum { FRAME_IDLE, FRAME_BORROWED, FRAME_IN_FLIGHT, FRAME_DONE };
+
+struct usb_monitor_frame {
+    usb_monitor_t *owner;
+    uint8_t  *data;
+    size_t    size;
+    int       dev_mem;          // from libusb_dev_mem_alloc (owned by mon->mem_owner)
+    int       locked;           // heap, mlock()ed
+    atomic_int state;           // FRAME_*; IN_FLIGHT -> DONE on the libusb event thread
+    unsigned  flags;
+    int       return_pending;   // returned while in flight
+    usb_monitor_frame_cb cb;
+    void     *user_data;
+    int       status, actual_length;
+    struct libusb_transfer *xfer;
+    usb_monitor_frame_t *next_done;
+};
+
+struct usb_monitor {
+    usb_monitor_config_t cfg;
+    libusb_context *ctx;
+    libusb_device_handle *handle;
+    libusb_device_handle *mem_owner;   // handle the dev_mem frames were allocated from
+    int interface_claimed, kernel_attached;
+    int width, height;
+    size_t frame_bytes;
+
+    usb_monitor_frame_t **frames;      // pool, capacity cfg.max_frames
+    int nframes;
+    int in_flight;                     // submitted and not yet delivered
+    int leaked;                        // frames left to libusb after a cancel timed out
+
+    pthread_mutex_t lock;              // done queue, IN_FLIGHT -> DONE, gone
+    usb_monitor_frame_t *done_head, *done_tail;
+    int gone;                          // device reported NO_DEVICE
+    int efd;                           // eventfd: completions waiting
+
+    pthread_t thread;
+    atomic_int thread_run;
+    int thread_started;
+
+    struct libevdev *evdev;
+    int touch_fd;
+    char touch_path[PATH_MAX];
+
+    uint64_t submitted, completed, failed, busy;
+};
+
+/* ---------- frame memory ---------- */
+
+static int frame_alloc_mem(usb_monitor_t *m, usb_monitor_frame_t *f, size_t size) {
+    uint8_t *p = m->handle ? libusb_dev_mem_alloc(m->handle, size) : NULL;
+    if (p) {
+        m->mem_owner = m->handle;
+        f->dev_mem = 1;
+        f->locked = 0;
+    } else {
+        void *mem = NULL;
+        if (posix_memalign(&mem, 4096, size) != 0) return USB_MONITOR_ERROR_NO_MEM;
+        p = (uint8_t*)mem;
+        f->dev_mem = 0;
+        f->locked = (mlock(p, size) == 0);   // best effort
+    }
+    f->data = p; f->size = size;
+    return 0;
+}
+
+static void frame_free_mem(usb_monitor_t *m, usb_monitor_frame_t *f) {
+    if (!f->data) return;
+    if (f->dev_mem) {
+        // disconnect_handle() frees or moves every dev_mem frame before its handle is closed
+        if (m->mem_owner) libusb_dev_mem_free(m->mem_owner, f->data, f->size);
+    }
+    else {
+        if (f->locked) munlock(f->data, f->size);
+        free(f->data);
+    }
+    f->data = NULL; f->size = 0; f->dev_mem = 0; f->locked = 0;
+}
+
+/* dev_mem belongs to the old handle: move the frame to heap memory, keeping its content */
+static int frame_move_to_heap(usb_monitor_t *m, usb_monitor_frame_t *f) {
+    usb_monitor_frame_t tmp = { 0 };
+    libusb_device_handle *h = m->handle;
+    m->handle = NULL;                     // force heap allocation
+    int r = frame_alloc_mem(m, &tmp, f->size);
+    m->handle = h;
+    if (r != 0) return r;
+    memcpy(tmp.data, f->data, f->size);
+    frame_free_mem(m, f);
+    f->data = tmp.data; f->size = tmp.size; f->dev_mem = 0; f->locked = tmp.locked;
+    return 0;
+}
+
+static void frame_destroy(usb_monitor_t *m, usb_monitor_frame_t *f) {
+    frame_free_mem(m, f);
+    if (f->xfer) libusb_free_transfer(f->xfer);
+    free(f);
+}
+
+/* ---------- completion queue / event servicing ---------- */
+
+static void LIBUSB_CALL frame_transfer_callback(struct libusb_transfer *xfer) {
+    usb_monitor_frame_t *f = (usb_monitor_frame_t*)xfer->user_data;
+    usb_monitor_t *m = f->owner;
+    pthread_mutex_lock(&m->lock);
+    f->status = xfer->status;
+    f->actual_length = xfer->actual_length;
+    f->state = FRAME_DONE;
+    f->next_done = NULL;
+    if (m->done_tail) m->done_tail->next_done = f; else m->done_head = f;
+    m->done_tail = f;
+    if (xfer->status == LIBUSB_TRANSFER_NO_DEVICE) m->gone = 1;
+    pthread_mutex_unlock(&m->lock);
+    uint64_t one = 1;
+    ssize_t w = write(m->efd, &one, sizeof(one));
+    (void)w;
+}
+
+static void mark_gone(usb_monitor_t *m) {
+    pthread_mutex_lock(&m->lock);
+    m->gone = 1;
+    pthread_mutex_unlock(&m->lock);
+    uint64_t one = 1;
+    ssize_t w = write(m->efd, &one, sizeof(one));
+    (void)w;
+}
+
+static void *event_thread_main(void *arg) {
+    usb_monitor_t *m = (usb_monitor_t*)arg;
+    while (atomic_load(&m->thread_run)) {
+        struct timeval tv = { 0, EVENT_THREAD_POLL_US };
+        int r = libusb_handle_events_timeout_completed(m->ctx, &tv, NULL);
+        if (r == LIBUSB_ERROR_NO_DEVICE) mark_gone(m);
+        else if (r < 0 && r != LIBUSB_ERROR_INTERRUPTED) usleep(EVENT_THREAD_POLL_US);
+    }
+    return NULL;
+}
+
+static int event_thread_start(usb_monitor_t *m) {
+    if (!m->cfg.event_thread || m->thread_started) return 0;
+    atomic_store(&m->thread_run, 1);
+    if (pthread_create(&m->thread, NULL, event_thread_main, m) != 0) return USB_MONITOR_ERROR_OTHER;
+    m->thread_started = 1;
+    return 0;
+}
+
+static void event_thread_stop(usb_monitor_t *m) {
+    if (!m->thread_started) return;
+    atomic_store(&m->thread_run, 0);
+    libusb_interrupt_event_handler(m->ctx);
+    pthread_join(m->thread, NULL);
+    m->thread_started = 0;
+}
+
+/* deliver queued completions on the caller's thread */
+static void dispatch_completions(usb_monitor_t *m) {
+    pthread_mutex_lock(&m->lock);
+    usb_monitor_frame_t *f = m->done_head;
+    m->done_head = m->done_tail = NULL;
+    pthread_mutex_unlock(&m->lock);
+    while (f) {
+        usb_monitor_frame_t *next = f->next_done;
+        m->in_flight--;
+        if (f->status == LIBUSB_TRANSFER_COMPLETED && f->actual_length == (int)f->size) m->completed++;
+        else m->failed++;
+        int keep = (f->flags & USB_MONITOR_SUBMIT_KEEP) && !f->return_pending;
+        f->state = keep ? FRAME_BORROWED : FRAME_IDLE;
+        f->return_pending = 0;
+        if (f->cb) f->cb(f, f->status, f->actual_length, f->user_data);
+        f = next;
+    }
+}
+
+/* a leaked frame's transfer may still complete during a later event pump: ignore it */
+static void LIBUSB_CALL leaked_transfer_callback(struct libusb_transfer *xfer) {
+    (void)xfer;
+}
+
+/*
+ * cancel whatever is in flight and wait until libusb has called back for all of it.
+ * Returns nonzero if some transfer never came back.
+ */
+static int quiesce_transfers(usb_monitor_t *m) {
+    event_thread_stop(m);
+    int pending = 0;
+    for (int i = 0; i < m->nframes; i++) {
+        if (m->frames[i]->state != FRAME_IN_FLIGHT) continue;
+        libusb_cancel_transfer(m->frames[i]->xfer);
+        pending = 1;
+    }
+    for (int round = 0; pending && round < QUIESCE_MAX_ROUNDS; round++) {
+        struct timeval tv = { 0, 10000 };
+        libusb_handle_events_timeout_completed(m->ctx, &tv, NULL);
+        pending = 0;
+        pthread_mutex_lock(&m->lock);
+        for (int i = 0; i < m->nframes; i++) if (m->frames[i]->state == FRAME_IN_FLIGHT) pending = 1;
+        pthread_mutex_unlock(&m->lock);
+    }
+    return pending;
+}
+
+/* ---------- device presence ---------- */
+
+/*
+ * Logic:
+ * - If handle is NULL -> consider disconnected.
+ * - Get libusb_device* from handle; read its bus number and port numbers (path).
+ * - Enumerate current libusb device list and try to find a device with same bus and same port-path.
+ * - If not found -> device physically disconnected.
+ * - Also treat libusb_get_device_descriptor() failures and libusb_handle_events_timeout_completed()
+ *   returning LIBUSB_ERROR_NO_DEVICE as disconnect.
+ *
+ * This is more robust in scenarios where the handle exists but the physical device has been unplugged.
+ */
+static bool device_disconnected(usb_monitor_t *m) {
+    if (!m->ctx || !m->handle) return true;
+
+    libusb_device *dev = libusb_get_device(m->handle);
+    if (!dev) return true;
+
+    // 1) Quick descriptor check: if libusb reports NO_DEVICE here, it's gone.
+    struct libusb_device_descriptor desc;
+    if (libusb_get_device_descriptor(dev, &desc) == LIBUSB_ERROR_NO_DEVICE) return true;
+
+    // 2) Get bus number and port numbers (port path)
+    uint8_t ports_saved[16];
+    int depth_saved = libusb_get_port_numbers(dev, ports_saved, sizeof(ports_saved));
+    uint8_t bus_saved = libusb_get_bus_number(dev);
+
+    libusb_device **devs = NULL;
+    ssize_t cnt = libusb_get_device_list(m->ctx, &devs);
+    if (cnt < 0) {
+        // can't list devices -> conservative: ask libusb event loop if it says device gone
+        struct timeval tv = {0, 0};
+        return libusb_handle_events_timeout_completed(m->ctx, &tv, NULL) == LIBUSB_ERROR_NO_DEVICE;
+    }
+
+    bool found = false;
+    for (ssize_t i = 0; i < cnt; ++i) {
+        libusb_device *d = devs[i];
+        if (libusb_get_bus_number(d) != bus_saved) continue;
+        if (depth_saved > 0) {
+            // compare port-number path
+            uint8_t ports_cur[16];
+            int depth_cur = libusb_get_port_numbers(d, ports_cur, sizeof(ports_cur));
+            if (depth_cur == depth_saved && memcmp(ports_saved, ports_cur, (size_t)depth_saved) == 0) {
+                found = true; break;
+            }
+        } else {
+            // fallback: same bus and idVendor/idProduct (best-effort)
+            struct libusb_device_descriptor ddesc;
+            if (libusb_get_device_descriptor(d, &ddesc) < 0) continue;
+            if (ddesc.idVendor == USB_MONITOR_VENDOR_ID && ddesc.idProduct == USB_MONITOR_PRODUCT_ID) {
+                found = true; break;
+            }
+        }
+    }
+    libusb_free_device_list(devs, 1);
+    if (!found) return true;
+
+    // 3) Final guard: still run event pump to check USB stack errors
+    struct timeval tv = {0, 0};
+    return libusb_handle_events_timeout_completed(m->ctx, &tv, NULL) == LIBUSB_ERROR_NO_DEVICE;
+}
+
+/* ---------- lifecycle / connect ---------- */
+
+void usb_monitor_config_init(usb_monitor_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->struct_size = sizeof(*cfg);
+    cfg->max_frames = DEFAULT_MAX_FRAMES;
+    cfg->max_in_flight = DEFAULT_MAX_IN_FLIGHT;
+    cfg->transfer_timeout_ms = DEFAULT_TIMEOUT_MS;
+}
+
+int usb_monitor_open(const usb_monitor_config_t *cfg, usb_monitor_t **out) {
+    if (!out) return USB_MONITOR_ERROR_INVALID_PARAM;
+    *out = NULL;
+    if (cfg && (cfg->struct_size < CONFIG_SIZE_MIN || cfg->struct_size > sizeof(*cfg)))
+        return USB_MONITOR_ERROR_INVALID_PARAM;
+    usb_monitor_t *m = (usb_monitor_t*)calloc(1, sizeof(*m));
+    if (!m) return USB_MONITOR_ERROR_NO_MEM;
+    usb_monitor_config_init(&m->cfg);
+    if (cfg) memcpy(&m->cfg, cfg, cfg->struct_size);   // fields the caller doesn't know keep their defaults
+    m->cfg.struct_size = sizeof(m->cfg);
+    if (m->cfg.max_frames <= 0) m->cfg.max_frames = DEFAULT_MAX_FRAMES;
+    if (m->cfg.max_in_flight <= 0) m->cfg.max_in_flight = DEFAULT_MAX_IN_FLIGHT;
+    if (m->cfg.transfer_timeout_ms <= 0) m->cfg.transfer_timeout_ms = DEFAULT_TIMEOUT_MS;
+    m->touch_fd = -1;
+    m->efd = -1;
+    m->frames = (usb_monitor_frame_t**)calloc((size_t)m->cfg.max_frames, sizeof(*m->frames));
+    if (!m->frames) { free(m); return USB_MONITOR_ERROR_NO_MEM; }
+    pthread_mutex_init(&m->lock, NULL);
+    m->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int r = m->efd < 0 ? USB_MONITOR_ERROR_OTHER : libusb_init(&m->ctx);
+    if (r < 0) {
+        if (m->efd >= 0) close(m->efd);
+        pthread_mutex_destroy(&m->lock);
+        free(m->frames); free(m);
+        return r;
+    }
+    *out = m;
+    return 0;
+}
+
+/* release interface and close the handle; kept frames survive (moved off dev_mem) */
+static void disconnect_handle(usb_monitor_t *m) {
+    if (!m->handle) return;
+    if (quiesce_transfers(m)) {
+        /*
+         * libusb still owns these transfers and may write their status, and the kernel may
+         * still read their buffers. Nothing about them can be freed safely, so they are
+         * dropped from the pool and leaked on purpose: the frame, its transfer and its memory.
+         * The event thread is stopped, so changing the callback here does not race.
+         */
+        int n = 0;
+        for (int i = 0; i < m->nframes; i++) {
+            usb_monitor_frame_t *f = m->frames[i];
+            if (f->state != FRAME_IN_FLIGHT) continue;
+            f->xfer->callback = leaked_transfer_callback;
+            m->frames[i--] = m->frames[--m->nframes];
+            m->in_flight--;
+            n++;
+        }
+        m->leaked += n;
+        fprintf(stderr, "usb_monitor: transfers still pending after cancel; %d frame(s) leaked\n", n);
+    }
+    // dev_mem must go back while its handle is still open
+    for (int i = 0; i < m->nframes; i++) {
+        usb_monitor_frame_t *f = m->frames[i];
+        if (!f->dev_mem) continue;
+        if (f->state == FRAME_IDLE) {
+            // re-allocated lazily from the next handle
+            frame_destroy(m, f);
+            m->frames[i--] = m->frames[--m->nframes];
+        } else if (frame_move_to_heap(m, f) != 0) {
+            fprintf(stderr, "usb_monitor: out of memory moving a frame off dev_mem\n");
+        }
+    }
+    if (m->interface_claimed) {
+        libusb_release_interface(m->handle, USB_MONITOR_SCREEN_INTERFACE_NUM);
+        m->interface_claimed = 0;
+        if (m->kernel_attached) { libusb_attach_kernel_driver(m->handle, USB_MONITOR_SCREEN_INTERFACE_NUM); m->kernel_attached = 0; }
+    }
+    libusb_close(m->handle);
+    m->handle = NULL;
+    m->mem_owner = NULL;
+}
+
+/* libusb connect (first matching device) */
+int usb_monitor_connect(usb_monitor_t *m) {
+    if (!m) return USB_MONITOR_ERROR_INVALID_PARAM;
+    libusb_device **devs = NULL;
+    ssize_t cnt = libusb_get_device_list(m->ctx, &devs);
+    if (cnt < 0) return (int)cnt;
+    libusb_device *target = NULL;
+    for (ssize_t i = 0; i < cnt; i++) {
+        libusb_device *d = devs[i];
+        struct libusb_device_descriptor desc;
+        if (libusb_get_device_descriptor(d, &desc) < 0) continue;
+        if (desc.idVendor == USB_MONITOR_VENDOR_ID && desc.idProduct == USB_MONITOR_PRODUCT_ID) {
+            libusb_ref_device(d); target = d; break;
+        }
+    }
+    libusb_free_device_list(devs, 1);
+    if (!target) return USB_MONITOR_ERROR_NOT_FOUND;
+
+    disconnect_handle(m);
+    int r = libusb_open(target, &m->handle);
+    libusb_unref_device(target);
+    if (r != 0) {
+        fprintf(stderr, "libusb_open failed: %s (%d)\n", libusb_error_name(r), r);
+        m->handle = NULL;
+        return r;
+    }
+    if (libusb_kernel_driver_active(m->handle, USB_MONITOR_SCREEN_INTERFACE_NUM) == 1) {
+        m->kernel_attached = libusb_detach_kernel_driver(m->handle, USB_MONITOR_SCREEN_INTERFACE_NUM) == 0;
+    }
+    r = libusb_claim_interface(m->handle, USB_MONITOR_SCREEN_INTERFACE_NUM);
+    if (r < 0) {
+        fprintf(stderr, "Failed to claim screen interface %d\n", USB_MONITOR_SCREEN_INTERFACE_NUM);
+        libusb_close(m->handle); m->handle = NULL;
+        return r;
+    }
+    m->interface_claimed = 1;
+    (void)usb_monitor_screen_offset_reset(m);   // optional offset reset
+
+    int w = m->cfg.width, h = m->cfg.height;
+    if (w <= 0 || h <= 0) {
+        usb_monitor_control_response_screen_info_t si;
+        if (usb_monitor_get_screen_info(m, &si) != 0 || si.screen_pixel_format != SCREEN_PIXEL_FORMAT_RGB565 ||
+            !si.screen_width || !si.screen_height) {
+            fprintf(stderr, "usb_monitor: GET_SCREEN_INFO failed; set width/height in the config\n");
+            disconnect_handle(m);
+            return USB_MONITOR_ERROR_NOT_SUPPORTED;
+        }
+        w = si.screen_width; h = si.screen_height;
+    }
+    if (m->frame_bytes && (w != m->width || h != m->height)) {
+        fprintf(stderr, "usb_monitor: panel changed from %dx%d to %dx%d\n", m->width, m->height, w, h);
+        disconnect_handle(m);
+        return USB_MONITOR_ERROR_NOT_SUPPORTED;
+    }
+    m->width = w; m->height = h;
+    m->frame_bytes = (size_t)w * h * 2;   // RGB565
+
+    pthread_mutex_lock(&m->lock);
+    m->gone = 0;
+    pthread_mutex_unlock(&m->lock);
+    return event_thread_start(m);
+}
+
+void usb_monitor_close(usb_monitor_t *m) {
+    if (!m) return;
+    usb_monitor_touch_close(m);
+    disconnect_handle(m);   // also stops the event thread
+    event_thread_stop(m);
+    for (int i = 0; i < m->nframes; i++) frame_destroy(m, m->frames[i]);
+    free(m->frames);
+    libusb_exit(m->ctx);
+    close(m->efd);
+    pthread_mutex_destroy(&m->lock);
+    free(m);
+}
+
+int usb_monitor_width(const usb_monitor_t *m) { return m->width; }
+int usb_monitor_height(const usb_monitor_t *m) { return m->height; }
+size_t usb_monitor_frame_bytes(const usb_monitor_t *m) { return m->frame_bytes; }
+const char *usb_monitor_error_name(int err) { return libusb_error_name(err); }
+
+/* ---------- control requests ---------- */
+
+int usb_monitor_control_request(usb_monitor_t *m, int interface_num, uint8_t request_type,
+                                uint16_t value, usb_monitor_control_response_t *resp) {
+    if (!m || !resp) return USB_MONITOR_ERROR_INVALID_PARAM;
+    if (!m->handle) return USB_MONITOR_ERROR_NO_DEVICE;
+    uint8_t recipient = interface_num < 0 ? LIBUSB_RECIPIENT_DEVICE : LIBUSB_RECIPIENT_INTERFACE;
+    memset(resp, 0, sizeof(*resp));
+    int r = libusb_control_transfer(m->handle,
+        LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_CLASS | recipient,
+        request_type, value, interface_num < 0 ? 0 : (uint16_t)interface_num,
+        (unsigned char *)resp, sizeof(*resp), CONTROL_TIMEOUT_MS);
+    if (r < 0) return r;
+    if (r < 3) return USB_MONITOR_ERROR_IO;   // response_code + request_type at least
+    return resp->generic.response_code;
+}
+
+int usb_monitor_get_version(usb_monitor_t *m, usb_monitor_control_response_get_version_t *out) {
+    usb_monitor_control_response_t resp;
+    int r = usb_monitor_control_request(m, -1, MONITOR_REQUEST_TYPE_GET_VERSION, 0, &resp);
+    if (r == 0 && out) *out = resp.version;
+    return r;
+}
+
+int usb_monitor_get_screen_info(usb_monitor_t *m, usb_monitor_control_response_screen_info_t *out) {
+    usb_monitor_control_response_t resp;
+    int r = usb_monitor_control_request(m, USB_MONITOR_SCREEN_INTERFACE_NUM, SCREEN_REQUEST_TYPE_GET_SCREEN_INFO, 0, &resp);
+    if (r == 0 && out) *out = resp.screen_info;
+    return r;
+}
+
+int usb_monitor_screen_offset_reset(usb_monitor_t *m) {
+    usb_monitor_control_response_t resp;
+    return usb_monitor_control_request(m, USB_MONITOR_SCREEN_INTERFACE_NUM, SCREEN_REQUEST_TYPE_OFFSET_RESET, 0, &resp);
+}
+
+int usb_monitor_screen_set_default_image(usb_monitor_t *m) {
+    usb_monitor_control_response_t resp;
+    return usb_monitor_control_request(m, USB_MONITOR_SCREEN_INTERFACE_NUM, SCREEN_REQUEST_TYPE_SET_SCREEN_DEFAULT_IMAGE, 0, &resp);
+}
+
+int usb_monitor_touch_controller_reset(usb_monitor_t *m) {
+    usb_monitor_control_response_t resp;
+    return usb_monitor_control_request(m, USB_MONITOR_TOUCH_INTERFACE_NUM, TOUCH_REQUEST_TYPE_RESET, 0, &resp);
+}
+
+/* ---------- frames ---------- */
+
+usb_monitor_frame_t *usb_monitor_frame_borrow(usb_monitor_t *m) {
+    if (!m || !m->frame_bytes) return NULL;
+    for (int i = 0; i < m->nframes; i++) {
+        usb_monitor_frame_t *f = m->frames[i];
+        if (f->state == FRAME_IDLE) { f->state = FRAME_BORROWED; return f; }
+    }
+    if (m->nframes >= m->cfg.max_frames) return NULL;
+    usb_monitor_frame_t *f = (usb_monitor_frame_t*)calloc(1, sizeof(*f));
+    if (!f) return NULL;
+    f->owner = m;
+    f->xfer = libusb_alloc_transfer(0);
+    if (!f->xfer || frame_alloc_mem(m, f, m->frame_bytes) != 0) { frame_destroy(m, f); return NULL; }
+    f->state = FRAME_BORROWED;
+    m->frames[m->nframes++] = f;
+    return f;
+}
+
+void *usb_monitor_frame_data(usb_monitor_frame_t *f) { return f->data; }
+size_t usb_monitor_frame_size(const usb_monitor_frame_t *f) { return f->size; }
+
+int usb_monitor_frame_busy(usb_monitor_t *m, const usb_monitor_frame_t *f) {
+    (void)m;
+    return f->state == FRAME_IN_FLIGHT || f->state == FRAME_DONE;   // DONE: not delivered yet
+}
+
+int usb_monitor_frame_submit(usb_monitor_t *m, usb_monitor_frame_t *f, unsigned flags,
+                             usb_monitor_frame_cb cb, void *user_data) {
+    if (!m || !f || f->owner != m || f->state != FRAME_BORROWED) return USB_MONITOR_ERROR_INVALID_PARAM;
+    if (!m->handle) return USB_MONITOR_ERROR_NO_DEVICE;
+    if (m->in_flight >= m->cfg.max_in_flight) {
+        // 이전 transfer가 끝나지 않은 것이 disconnect 때문인지 확인
+        if (device_disconnected(m)) { mark_gone(m); return USB_MONITOR_ERROR_NO_DEVICE; }
+        m->busy++;
+        return USB_MONITOR_ERROR_BUSY;
+    }
+    libusb_fill_bulk_transfer(f->xfer, m->handle, USB_MONITOR_EP_OUT, f->data, (int)f->size,
+                              frame_transfer_callback, f, (unsigned)m->cfg.transfer_timeout_ms);
+    f->flags = flags; f->cb = cb; f->user_data = user_data;
+    f->return_pending = 0;
+    f->state = FRAME_IN_FLIGHT;   // before submit: the event thread may complete it right away
+    int r = libusb_submit_transfer(f->xfer);
+    if (r < 0) {
+        f->state = FRAME_BORROWED;
+        if (r == LIBUSB_ERROR_NO_DEVICE) mark_gone(m);
+        return r;
+    }
+    m->in_flight++;
+    m->submitted++;
+    return 0;
+}
+
+void usb_monitor_frame_return(usb_monitor_t *m, usb_monitor_frame_t *f) {
+    if (!m || !f) return;
+    if (usb_monitor_frame_busy(m, f)) f->return_pending = 1;   // idle once delivered
+    else f->state = FRAME_IDLE;
+}
+
+/* ====== send_sync (chunked) ====== */
+int usb_monitor_send_sync(usb_monitor_t *m, const void *data, size_t len) {
+    if (!m || !data) return USB_MONITOR_ERROR_INVALID_PARAM;
+    if (!m->handle) return USB_MONITOR_ERROR_NO_DEVICE;
+    const uint8_t *p = (const uint8_t*)data;
+    size_t offset = 0;
+    while (offset < len) {
+        int chunk = len - offset > PACKET_SIZE ? PACKET_SIZE : (int)(len - offset);
+        int transferred = 0;
+        int r = libusb_bulk_transfer(m->handle, USB_MONITOR_EP_OUT, (unsigned char*)(p + offset), chunk,
+                                     &transferred, (unsigned)m->cfg.transfer_timeout_ms);
+        if (r == LIBUSB_ERROR_NO_DEVICE) { mark_gone(m); return r; }
+        if (r != 0) {
+            fprintf(stderr, "libusb_bulk_transfer error at offset %zu: %s (%d)\n", offset, libusb_error_name(r), r);
+            return r;
+        }
+        if (transferred <= 0) {
+            fprintf(stderr, "libusb_bulk_transfer transferred 0 at offset %zu\n", offset);
+            return USB_MONITOR_ERROR_IO;
+        }
+        offset += (size_t)transferred;
+    }
+    return 0;
+}
+
+int usb_monitor_handle_events(usb_monitor_t *m, int timeout_ms) {
+    if (!m) return USB_MONITOR_ERROR_INVALID_PARAM;
+    if (timeout_ms < 0) timeout_ms = 0;
+    if (!m->thread_started) {
+        struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+        int r = libusb_handle_events_timeout_completed(m->ctx, &tv, NULL);
+        if (r == LIBUSB_ERROR_NO_DEVICE) mark_gone(m);
+        else if (r < 0) return r;
+    } else if (timeout_ms > 0) {
+        struct pollfd pfd = { m->efd, POLLIN, 0 };
+        (void)poll(&pfd, 1, timeout_ms);
+    }
+    uint64_t cnt;
+    while (read(m->efd, &cnt, sizeof(cnt)) == (ssize_t)sizeof(cnt)) {}
+    dispatch_completions(m);
+    pthread_mutex_lock(&m->lock);
+    int gone = m->gone;
+    pthread_mutex_unlock(&m->lock);
+    return gone ? USB_MONITOR_ERROR_NO_DEVICE : 0;
+}
+
+int usb_monitor_get_fd(const usb_monitor_t *m) { return m->efd; }
+
+int usb_monitor_get_stats(const usb_monitor_t *m, usb_monitor_stats_t *st) {
+    if (!m || !st || st->struct_size < STATS_SIZE_MIN) return USB_MONITOR_ERROR_INVALID_PARAM;
+    usb_monitor_stats_t s;
+    memset(&s, 0, sizeof(s));
+    s.struct_size = st->struct_size < sizeof(s) ? st->struct_size : sizeof(s);
+    for (int i = 0; i < m->nframes; i++) {
+        const usb_monitor_frame_t *f = m->frames[i];
+        s.frames++;
+        if (f->state == FRAME_IDLE) s.frames_idle++;
+        if (f->dev_mem) s.frames_dev_mem++;
+        s.bytes += f->size;
+        if (f->dev_mem || f->locked) s.bytes_pinned += f->size;
+    }
+    s.in_flight = m->in_flight;
+    s.submitted = m->submitted; s.completed = m->completed;
+    s.failed = m->failed; s.busy = m->busy;
+    s.frames_leaked = m->leaked;
+    memcpy(st, &s, s.struct_size);   // a caller built against an older header gets its prefix only
+    return 0;
+}
+
+/* ---------- functions for matching event node to libusb device ---------- */
+
+/* read small file into buffer (trim newline) */
+static int read_file_to_buf(const char *path, char *buf, size_t sz) {
+    if (!path || !buf) return -1;
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    if (!fgets(buf, (int)sz, f)) { fclose(f); return -1; }
+    // trim newline
+    size_t L = strlen(buf);
+    while (L > 0 && (buf[L-1] == '\n' || buf[L-1] == '\r')) { buf[L-1] = '\0'; L--; }
+    fclose(f);
+    return 0;
+}
+
+/*
+ * Try to find /dev/input/eventN which belongs to the same USB device as the libusb handle.
+ * We compare idVendor/idProduct and, if available, iSerialNumber (string desc).
+ *
+ * out_event_path must have size at least PATH_MAX.
+ * Returns 0 on success and writes "/dev/input/eventN" into out_event_path. -1 on failure.
+ */
+static int find_event_for_libusb_device(libusb_device_handle *h, char *out_event_path, size_t out_sz) {
+    if (!h || !out_event_path) return -1;
+
+    libusb_device *dev = libusb_get_device(h);
+    if (!dev) return -1;
+
+    struct libusb_device_descriptor desc;
+    if (libusb_get_device_descriptor(dev, &desc) < 0) return -1;
+
+    // optional serial string
+    char serial_str[256] = {0};
+    if (desc.iSerialNumber) {
+        if (libusb_get_string_descriptor_ascii(h, desc.iSerialNumber,
+                                              (unsigned char*)serial_str, sizeof(serial_str)) < 0) {
+            serial_str[0] = '\0';
+        }
+    }
+
+    // vendor/product from descriptor (hex)
+    unsigned short vid = desc.idVendor;
+    unsigned short pid = desc.idProduct;
+
+    // iterate /dev/input/eventN
+    for (int i = 0; i < TOUCH_EVENT_SCAN_MAX; ++i) {
+        char devnode[64]; snprintf(devnode, sizeof(devnode), "/dev/input/event%d", i);
+        // if node doesn't exist skip
+        if (access(devnode, R_OK) != 0) continue;
+
+        // resolve sysfs path for this event: /sys/class/input/eventN/device (resolve symlink)
+        char syslink[PATH_MAX];
+        snprintf(syslink, sizeof(syslink), "/sys/class/input/event%d/device", i);
+
+        char resolved[PATH_MAX];
+        if (!realpath(syslink, resolved)) continue;
+
+        // walk up directories until we find idVendor && idProduct files (or root)
+        char cur[PATH_MAX];
+        strncpy(cur, resolved, sizeof(cur));
+        cur[sizeof(cur)-1] = '\0';
+        bool matched = false;
+        while (1) {
+            // build candidate idVendor path
+            char vid_path[PATH_MAX], pid_path[PATH_MAX], serial_path[PATH_MAX];
+            snprintf(vid_path, sizeof(vid_path), "%s/idVendor", cur);
+            snprintf(pid_path, sizeof(pid_path), "%s/idProduct", cur);
+            snprintf(serial_path, sizeof(serial_path), "%s/serial", cur);
+
+            if (access(vid_path, R_OK) == 0 && access(pid_path, R_OK) == 0) {
+                char vbuf[64], pbuf[64];
+                if (read_file_to_buf(vid_path, vbuf, sizeof(vbuf)) < 0) break;
+                if (read_file_to_buf(pid_path, pbuf, sizeof(pbuf)) < 0) break;
+                unsigned int v = (unsigned int)strtoul(vbuf, NULL, 16);
+                unsigned int p = (unsigned int)strtoul(pbuf, NULL, 16);
+                if ((unsigned int)vid == v && (unsigned int)pid == p) {
+                    // if serial is available from libusb, try to match sysfs 'serial' if present
+                    if (serial_str[0] != '\0' && access(serial_path, R_OK) == 0) {
+                        char sfs[256] = {0};
+                        if (read_file_to_buf(serial_path, sfs, sizeof(sfs)) == 0) {
+                            if (strcmp(serial_str, sfs) == 0) {
+                                matched = true; // vendor/pid and serial match
+                            } else {
+                                matched = false;
+                            }
+                        } else {
+                            matched = false;
+                        }
+                    } else {
+                        // serial not available or not present; accept vendor/pid match
+                        matched = true;
+                    }
+                }
+                // either way, break from loop to check matched flag
+                break;
+            }
+
+            // go one level up
+            char *slash = strrchr(cur, '/');
+            if (!slash || slash == cur) break;
+            *slash = '\0';
+        } // end walk up
+
+        if (matched) {
+            // success: return devnode
+            strncpy(out_event_path, devnode, out_sz);
+            out_event_path[out_sz-1] = '\0';
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int autodetect_touch_event_path(char *out_path, size_t out_sz) {
+    // kept as fallback: checks for any event node with ABS capabilities
+    for (int i = 0; i < TOUCH_EVENT_SCAN_MAX; i++) {
+        char p[64]; snprintf(p, sizeof(p), "/dev/input/event%d", i);
+        if (access(p, R_OK) != 0) continue;
+        int fd = open(p, O_RDONLY | O_NONBLOCK);
+        if (fd < 0) continue;
+        struct libevdev *d = NULL;
+        if (libevdev_new_from_fd(fd, &d) == 0) {
+            bool ok = libevdev_has_event_type(d, EV_ABS) &&
+                      ((libevdev_has_event_code(d, EV_ABS, ABS_MT_POSITION_X) &&
+                        libevdev_has_event_code(d, EV_ABS, ABS_MT_POSITION_Y)) ||
+                       (libevdev_has_event_code(d, EV_ABS, ABS_X) &&
+                        libevdev_has_event_code(d, EV_ABS, ABS_Y)));
+            if (ok) {
+                strncpy(out_path, p, out_sz); out_path[out_sz-1] = '\0';
+                libevdev_free(d); close(fd); return 0;
+            }
+            libevdev_free(d);
+        }
+        close(fd);
+    }
+    return -1;
+}
+
+/* ---------- touch ---------- */
+
+int usb_monitor_touch_open(usb_monitor_t *m, const char *fallback_path) {
+    if (!m) return USB_MONITOR_ERROR_INVALID_PARAM;
+    usb_monitor_touch_close(m);
+    char path[PATH_MAX] = {0};
+    // first try to find the event node belonging to the same libusb device
+    if (find_event_for_libusb_device(m->handle, path, sizeof(path)) != 0) {
+        if (fallback_path) {
+            strncpy(path, fallback_path, sizeof(path) - 1);
+            path[sizeof(path) - 1] = '\0';
+        } else if (autodetect_touch_event_path(path, sizeof(path)) != 0) {
+            return USB_MONITOR_ERROR_NOT_FOUND;   // fallback autodetect (any ABS-capable event) failed
+        }
+    }
+    int fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) return errno == EACCES ? USB_MONITOR_ERROR_ACCESS : USB_MONITOR_ERROR_IO;
+    struct libevdev *dev = NULL;
+    if (libevdev_new_from_fd(fd, &dev) < 0) { close(fd); return USB_MONITOR_ERROR_IO; }
+    m->touch_fd = fd; m->evdev = dev;
+    memcpy(m->touch_path, path, sizeof(path));
+    return 0;
+}
+
+void usb_monitor_touch_close(usb_monitor_t *m) {
+    if (!m) return;
+    if (m->evdev) libevdev_free(m->evdev);
+    if (m->touch_fd >= 0) close(m->touch_fd);
+    m->evdev = NULL; m->touch_fd = -1;
+    m->touch_path[0] = '\0';
+}
+
+const char *usb_monitor_touch_path(const usb_monitor_t *m) { return m->touch_path; }
+int usb_monitor_touch_fd(const usb_monitor_t *m) { return m->touch_fd; }
+
+/* init touch caps from libevdev device */
+int usb_monitor_touch_get_decoder(const usb_monitor_t *m, usb_monitor_touch_t *t) {
+    if (!m || !t || t->struct_size < TOUCH_SIZE_MIN) return USB_MONITOR_ERROR_INVALID_PARAM;
+    if (!m->evdev) return USB_MONITOR_ERROR_NOT_FOUND;
+    struct libevdev *dev = m->evdev;
+    usb_monitor_touch_t d;
+    memset(&d, 0, sizeof(d));
+    d.struct_size = t->struct_size < sizeof(d) ? t->struct_size : sizeof(d);
+    d.have_mt = libevdev_has_event_code(dev, EV_ABS, ABS_MT_POSITION_X) &&
+                libevdev_has_event_code(dev, EV_ABS, ABS_MT_POSITION_Y);
+    d.have_st = libevdev_has_event_code(dev, EV_ABS, ABS_X) &&
+                libevdev_has_event_code(dev, EV_ABS, ABS_Y);
+    const struct input_absinfo *ax = NULL, *ay = NULL;
+    if (d.have_mt) { ax = libevdev_get_abs_info(dev, ABS_MT_POSITION_X); ay = libevdev_get_abs_info(dev, ABS_MT_POSITION_Y); }
+    else if (d.have_st) { ax = libevdev_get_abs_info(dev, ABS_X); ay = libevdev_get_abs_info(dev, ABS_Y); }
+    if (ax && ay) {
+        d.abs_min_x = ax->minimum; d.abs_max_x = ax->maximum;
+        d.abs_min_y = ay->minimum; d.abs_max_y = ay->maximum;
+    } else {
+        d.abs_min_x = 0; d.abs_max_x = 65535;
+        d.abs_min_y = 0; d.abs_max_y = 65535;
+    }
+    d.panel_w = m->width; d.panel_h = m->height;
+    d.pending_x = d.pending_y = -1;
+    memcpy(t, &d, d.struct_size);   // a caller built against an older header gets its prefix only
+    return 0;
+}
+
+int usb_monitor_touch_next(usb_monitor_t *m, struct input_event *ev) {
+    if (!m || !m->evdev || !ev) return USB_MONITOR_ERROR_INVALID_PARAM;
+    int rc = libevdev_next_event(m->evdev, LIBEVDEV_READ_FLAG_NORMAL, ev);
+    if (rc == LIBEVDEV_READ_STATUS_SUCCESS || rc == LIBEVDEV_READ_STATUS_SYNC) return 1;
+    if (rc == -EAGAIN) return 0;
+    return rc == -ENODEV ? USB_MONITOR_ERROR_NO_DEVICE : USB_MONITOR_ERROR_IO;
+}
+
+int usb_monitor_touch_decode(usb_monitor_touch_t *t, const struct input_event *ev, int *x, int *y) {
+    if (!t || !ev) return 0;
+    int code_x, code_y;
+    if (t->have_mt) { code_x = ABS_MT_POSITION_X; code_y = ABS_MT_POSITION_Y; }
+    else if (t->have_st) { code_x = ABS_X; code_y = ABS_Y; }
+    else return 0;
+    if (ev->type == EV_ABS) {
+        if (ev->code == code_x) t->pending_x = ev->value;
+        else if (ev->code == code_y) t->pending_y = ev->value;
+        return 0;
+    }
+    if (ev->type != EV_SYN || ev->code != SYN_REPORT || t->pending_x < 0 || t->pending_y < 0) return 0;
+    int rx = t->abs_max_x - t->abs_min_x, ry = t->abs_max_y - t->abs_min_y;
+    if (rx <= 0) rx = 1;
+    if (ry <= 0) ry = 1;
+    if (x) *x = (int)((long long)(t->pending_x - t->abs_min_x) * (t->panel_w - 1) / rx);
+    if (y) *y = (int)((long long)(t->pending_y - t->abs_min_y) * (t->panel_h - 1) / ry);
+    t->pending_x = t->pending_y = -1;
+    return 1;
+}
@@ -0,0 +1,187 @@
+#ifndef __USB_MONITOR_H__
+#define __USB_MONITOR_H__
+
+/*
+ * libusbmonitor: in-process access to the 1fc9:8335 USB monitor (RGB565 screen + touch).
+ *
+ *  - connect/discovery    usb_monitor_open(), usb_monitor_connect()
+ *  - control requests     request types of usb_monitor_control.h
+ *  - frame submission     borrow a transfer-ready buffer, fill it in place, submit it
+ *                         asynchronously. No copy is made between the caller and the kernel:
+ *                         buffers are usbfs DMA memory (libusb_dev_mem_alloc) when the kernel
+ *                         supports it, otherwise page aligned mlock()ed heap memory.
+ *  - touch                evdev node of the same physical device, raw events, and a decoder
+ *                         from raw axis values to panel coordinates.
+ *
+ * Completions are delivered by usb_monitor_handle_events() on the calling thread. Without
+ * event_thread that call also services libusb; with event_thread libusb is serviced on an
+ * internal thread and usb_monitor_get_fd() becomes readable whenever completions are waiting,
+ * so the fd can sit in the caller's poll()/epoll loop.
+ *
+ * Apart from polling the fd, a usb_monitor_t must only be used from one thread.
+ * Errors are negative and have the same values as libusb_error.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/input.h>
+
+#include "usb_monitor_control.h"
+
+#define USB_MONITOR_API_VERSION 1
+
+#if defined(__GNUC__)
+#define USB_MONITOR_API __attribute__((visibility("default")))
+#else
+#define USB_MONITOR_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define USB_MONITOR_VENDOR_ID            0x1fc9
+#define USB_MONITOR_PRODUCT_ID           0x8335
+#define USB_MONITOR_TOUCH_INTERFACE_NUM  0
+#define USB_MONITOR_SCREEN_INTERFACE_NUM 1
+#define USB_MONITOR_EP_OUT               0x03
+
+enum usb_monitor_error {
+    USB_MONITOR_SUCCESS             = 0,
+    USB_MONITOR_ERROR_IO            = -1,
+    USB_MONITOR_ERROR_INVALID_PARAM = -2,
+    USB_MONITOR_ERROR_ACCESS        = -3,
+    USB_MONITOR_ERROR_NO_DEVICE     = -4,
+    USB_MONITOR_ERROR_NOT_FOUND     = -5,
+    USB_MONITOR_ERROR_BUSY          = -6,
+    USB_MONITOR_ERROR_TIMEOUT       = -7,
+    USB_MONITOR_ERROR_NO_MEM        = -11,
+    USB_MONITOR_ERROR_NOT_SUPPORTED = -12,
+    USB_MONITOR_ERROR_OTHER         = -99,
+};
+
+/* completion status of a submitted frame (same values as libusb_transfer_status) */
+enum usb_monitor_frame_status {
+    USB_MONITOR_FRAME_COMPLETED = 0,
+    USB_MONITOR_FRAME_ERROR     = 1,
+    USB_MONITOR_FRAME_TIMED_OUT = 2,
+    USB_MONITOR_FRAME_CANCELLED = 3,
+    USB_MONITOR_FRAME_STALL     = 4,
+    USB_MONITOR_FRAME_NO_DEVICE = 5,
+    USB_MONITOR_FRAME_OVERFLOW  = 6,
+};
+
+typedef struct usb_monitor usb_monitor_t;
+typedef struct usb_monitor_frame usb_monitor_frame_t;
+
+/*
+ * Both structs start with struct_size (sizeof as the caller was compiled). Fields are only ever
+ * appended, so a caller built against an older header gets defaults for the newer ones.
+ */
+typedef struct usb_monitor_config {
+    size_t struct_size;       // set by usb_monitor_config_init()
+    int width, height;        // panel size in pixels; 0: ask the device (GET_SCREEN_INFO)
+    int max_frames;           // transfer-ready buffers the pool may hold (default 4)
+    int max_in_flight;        // submitted frames not yet completed (default 1)
+    int transfer_timeout_ms;  // per frame (default 1000)
+    int event_thread;         // service libusb on an internal thread (default 0)
+} usb_monitor_config_t;
+
+typedef struct usb_monitor_stats {
+    size_t   struct_size;           // set by the caller: sizeof(usb_monitor_stats_t)
+    int      frames, frames_idle, frames_dev_mem, in_flight;
+    size_t   bytes, bytes_pinned;   // pinned: dev_mem or mlock()ed
+    uint64_t submitted, completed, failed, busy;
+    int      frames_leaked;         // still owned by libusb after a cancel timed out
+} usb_monitor_stats_t;
+
+/*
+ * Touch decoder: absolute axis range of the evdev node and the panel size it maps onto.
+ * Plain data so that recorded input can be decoded without a device. Versioned like the
+ * structs above: get_decoder fills only the struct_size prefix the caller knows.
+ */
+typedef struct usb_monitor_touch {
+    size_t struct_size;         // set by the caller: sizeof(usb_monitor_touch_t)
+    int have_mt, have_st;
+    int abs_min_x, abs_max_x;
+    int abs_min_y, abs_max_y;
+    int panel_w, panel_h;
+    int pending_x, pending_y;   // axis values since the last SYN_REPORT, -1: none
+} usb_monitor_touch_t;
+
+/*
+ * Called from usb_monitor_handle_events() once the frame's transfer has finished.
+ * Without USB_MONITOR_SUBMIT_KEEP the frame is already back in the pool at that point.
+ */
+typedef void (*usb_monitor_frame_cb)(usb_monitor_frame_t *frame, int status, int actual_length,
+                                     void *user_data);
+
+#define USB_MONITOR_SUBMIT_KEEP 0x1   // frame stays borrowed after completion (resubmit later)
+
+/* lifecycle. open: INVALID_PARAM when cfg->struct_size is not one this library knows */
+USB_MONITOR_API void usb_monitor_config_init(usb_monitor_config_t *cfg);
+USB_MONITOR_API int  usb_monitor_open(const usb_monitor_config_t *cfg, usb_monitor_t **out);
+USB_MONITOR_API void usb_monitor_close(usb_monitor_t *m);
+/* one attempt; NOT_FOUND while no device is plugged in. Also used to reconnect. */
+USB_MONITOR_API int  usb_monitor_connect(usb_monitor_t *m);
+USB_MONITOR_API int  usb_monitor_width(const usb_monitor_t *m);
+USB_MONITOR_API int  usb_monitor_height(const usb_monitor_t *m);
+USB_MONITOR_API size_t usb_monitor_frame_bytes(const usb_monitor_t *m);
+USB_MONITOR_API const char *usb_monitor_error_name(int err);
+
+/*
+ * Control requests. interface_num < 0 addresses the root device. Returns a negative error
+ * if the request itself failed, otherwise the device's response_code (0: ok).
+ */
+USB_MONITOR_API int usb_monitor_control_request(usb_monitor_t *m, int interface_num, uint8_t request_type,
+                                                uint16_t value, usb_monitor_control_response_t *resp);
+USB_MONITOR_API int usb_monitor_get_version(usb_monitor_t *m, usb_monitor_control_response_get_version_t *out);
+USB_MONITOR_API int usb_monitor_get_screen_info(usb_monitor_t *m, usb_monitor_control_response_screen_info_t *out);
+USB_MONITOR_API int usb_monitor_screen_offset_reset(usb_monitor_t *m);
+USB_MONITOR_API int usb_monitor_screen_set_default_image(usb_monitor_t *m);
+USB_MONITOR_API int usb_monitor_touch_controller_reset(usb_monitor_t *m);
+
+/*
+ * Frames. borrow returns an idle buffer of usb_monitor_frame_bytes() or NULL when the pool
+ * is exhausted. The caller owns it until submit (or return). A frame must not be written
+ * while usb_monitor_frame_busy(). The data pointer is stable, except that a reconnect may
+ * move kept frames out of the old device's DMA memory (contents preserved). A frame whose
+ * transfer could not be cancelled on disconnect is left to libusb and stays busy for good.
+ */
+USB_MONITOR_API usb_monitor_frame_t *usb_monitor_frame_borrow(usb_monitor_t *m);
+USB_MONITOR_API void  *usb_monitor_frame_data(usb_monitor_frame_t *f);
+USB_MONITOR_API size_t usb_monitor_frame_size(const usb_monitor_frame_t *f);
+USB_MONITOR_API int    usb_monitor_frame_busy(usb_monitor_t *m, const usb_monitor_frame_t *f);
+/* BUSY when max_in_flight frames are pending (the frame stays with the caller) */
+USB_MONITOR_API int    usb_monitor_frame_submit(usb_monitor_t *m, usb_monitor_frame_t *f, unsigned flags,
+                                                usb_monitor_frame_cb cb, void *user_data);
+USB_MONITOR_API void   usb_monitor_frame_return(usb_monitor_t *m, usb_monitor_frame_t *f);
+/* blocking, chunked send of len bytes from any memory */
+USB_MONITOR_API int    usb_monitor_send_sync(usb_monitor_t *m, const void *data, size_t len);
+
+/* run completions; waits up to timeout_ms for events. NO_DEVICE once the device is gone. */
+USB_MONITOR_API int  usb_monitor_handle_events(usb_monitor_t *m, int timeout_ms);
+USB_MONITOR_API int  usb_monitor_get_fd(const usb_monitor_t *m);
+/* fills st->struct_size bytes; INVALID_PARAM when struct_size is not set */
+USB_MONITOR_API int  usb_monitor_get_stats(const usb_monitor_t *m, usb_monitor_stats_t *st);
+
+/*
+ * Touch. touch_open looks for the evdev node of the connected device, then tries
+ * fallback_path (if given), then any node with absolute axes.
+ */
+USB_MONITOR_API int  usb_monitor_touch_open(usb_monitor_t *m, const char *fallback_path);
+USB_MONITOR_API void usb_monitor_touch_close(usb_monitor_t *m);
+USB_MONITOR_API const char *usb_monitor_touch_path(const usb_monitor_t *m);
+USB_MONITOR_API int  usb_monitor_touch_fd(const usb_monitor_t *m);
+/* decoder for the opened node, mapping onto the panel. INVALID_PARAM: t->struct_size too small */
+USB_MONITOR_API int  usb_monitor_touch_get_decoder(const usb_monitor_t *m, usb_monitor_touch_t *t);
+/* non-blocking: 1 event read, 0 none pending, negative error */
+USB_MONITOR_API int  usb_monitor_touch_next(usb_monitor_t *m, struct input_event *ev);
+/* 1 when ev completes a touch point (written to x, y in panel pixels) */
+USB_MONITOR_API int  usb_monitor_touch_decode(usb_monitor_touch_t *t, const struct input_event *ev, int *x, int *y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __USB_MONITOR_H__